@@ -2,6 +2,7 @@
 #define BVH_H
 
 #include "shapes/shape.h"
+#include "arena.h"
 #include <vector>      
 #include <algorithm>   
 #include <iostream>    
@@ -20,10 +21,50 @@ class BVHNode : public Shape {
 public:
     Shape* left;
     Shape* right;
-    AABB box;
+    AABB box;               // bounds at time 0 (all times unless moving)
+    AABB box1;              // bounds at time 1, when moving
+    bool moving = false;
+
+    // SAH cost of the subtree, relative to this node's area
+    float cost = 1.0f;
+    float buildCost = 1.0f;     // cost when the subtree was built
+
+    // Set on the root only: the arenas holding every node below it
+    NodePool* pool = nullptr;
+
+    // Median split tree, children allocated from a pool owned by this root
+    BVHNode(std::vector<Shape*>& shapes, size_t start, size_t end) : pool(new NodePool()) {
+        split(shapes, start, end, pool->acquire());
+    }
+
+    // Node from children that are already built (used by the builders)
+    // A leaf has the primitive in left and no right child
+    BVHNode(Shape* l, Shape* r, const AABB& b) : left(l), right(r), box(b) {
+        fitTimeBounds();
+        computeCost();
+        buildCost = cost;
+    }
+
+    // Heap root for a tree built in pool, which it takes over
+    static BVHNode* makeRoot(const BVHNode* top, NodePool* pool) {
+        BVHNode* root = new BVHNode(top->left, top->right, top->box);
+        root->pool = pool;
+        return root;
+    }
+
+    // Nodes are never deleted one by one, the whole tree goes with its pool
+    virtual ~BVHNode() {
+        delete pool;
+    }
+
+private:
+    friend class Arena;
+    BVHNode(std::vector<Shape*>& shapes, size_t start, size_t end, Arena& arena) {
+        split(shapes, start, end, arena);
+    }
+
+    void split(std::vector<Shape*>& shapes, size_t start, size_t end, Arena& arena) {
 
-    BVHNode(std::vector<Shape*>& shapes, size_t start, size_t end) {
-        
         // Compute bounds for all shapes
         for (size_t i = start; i < end; ++i) {
             box.expand(shapes[i]->bounds());
@@ -48,22 +89,25 @@ public:
             
             size_t mid = start + object_span / 2;
         
-            left = new BVHNode(shapes, start, mid);  
-            right = new BVHNode(shapes, mid, end);   
+            left = arena.makeTrivial<BVHNode>(shapes, start, mid, arena);
+            right = arena.makeTrivial<BVHNode>(shapes, mid, end, arena);
         }
-    }
 
-    virtual ~BVHNode() {
-        if (right != nullptr) {
-        delete left;
-        delete right;
-        }
+        fitTimeBounds();
+        computeCost();
+        buildCost = cost;
     }
 
+public:
+
     bool intersect(const Ray& ray, HitInfo& hit) const override {
         
-        // Check box intersection
-        if (!box.intersect(ray, hit.t)) {
+        RT_STAT(STAT_BVH_NODES);
+
+        // Check box intersection, at the ray's time if anything below moves
+        if (moving) {
+            if (!boxAt(ray.time).intersect(ray, hit.t)) return false;
+        } else if (!box.intersect(ray, hit.t)) {
             return false;
         }
 
@@ -80,11 +124,78 @@ public:
     }
 
     AABB bounds() const override { 
-        return box; 
+        return moving ? AABB::combine(box, box1) : box; 
+    }
+
+    AABB boundsAt(float t) const override {
+        return moving ? boxAt(t) : box;
+    }
+
+    bool isMoving() const override {
+        return moving;
+    }
+
+    // Linear blend of the end boxes, conservative for linear motion
+    AABB boxAt(float t) const {
+        AABB b;
+        b.min = box.min + (box1.min - box.min) * t;
+        b.max = box.max + (box1.max - box.max) * t;
+        return b;
+    }
+
+    // Replace box with per-time bounds when a child moves
+    void fitTimeBounds() {
+        moving = left->isMoving() || (right != nullptr && right->isMoving());
+        if (!moving) return;
+
+        box = left->boundsAt(0.0f);
+        box1 = left->boundsAt(1.0f);
+        if (right != nullptr) {
+            box.expand(right->boundsAt(0.0f));
+            box1.expand(right->boundsAt(1.0f));
+        }
+    }
+
+    // Recompute bounds bottom-up after shapes moved, O(n)
+    void refit() override {
+        left->refit();
+        if (right != nullptr) {
+            right->refit();
+            box = AABB::combine(left->bounds(), right->bounds());
+        } else {
+            box = left->bounds();
+        }
+        fitTimeBounds();
+        computeCost();
+    }
+
+    // Cost = 1 + sum over children of (child area / area) * child cost
+    // Children of internal nodes are always BVHNodes
+    void computeCost() {
+        if (right == nullptr) {
+            cost = 1.0f;
+            return;
+        }
+        const BVHNode* l = static_cast<const BVHNode*>(left);
+        const BVHNode* r = static_cast<const BVHNode*>(right);
+
+        float area = bounds().surfaceArea();
+        if (area <= 0.0f) {
+            cost = 1.0f + l->cost + r->cost;
+            return;
+        }
+        cost = 1.0f + (l->bounds().surfaceArea() * l->cost + r->bounds().surfaceArea() * r->cost) / area;
+    }
+
+    // Bytes used by this node and the nodes below it
+    size_t memoryBytes() const {
+        if (right == nullptr) return sizeof(BVHNode);
+        return sizeof(BVHNode) + static_cast<const BVHNode*>(left)->memoryBytes()
+                               + static_cast<const BVHNode*>(right)->memoryBytes();
     }
 
     Vector3 centroid() const override { 
-        return box.centre(); 
+        return bounds().centre(); 
     }
 };
 
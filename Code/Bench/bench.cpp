@@ -0,0 +1,302 @@
+#include "../raytracer.h"
+#include "../scene.h"
+#include "../accel.h"
+#include "../image.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <filesystem>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Renders a fixed set of ASCII scenes and compares against a stored baseline
+// Every run is a fresh process: the renderer's RNG starts from its fixed seed
+// and peak RSS belongs to that scene alone. Built with RT_STATS for ray counts.
+
+struct BenchScene {
+    const char* name;
+    int width, height, spp, shadowSamples, glossySamples;
+};
+
+static const BenchScene SCENES[] = {
+    { "Test1",       320, 180, 4, 4, 4 },
+    { "spheres",     320, 180, 4, 4, 4 },
+    { "glass",       320, 180, 4, 4, 4 },
+    { "reflection",  320, 180, 4, 4, 4 },
+    { "texture",     320, 180, 4, 4, 4 },
+    { "softshadows", 320, 180, 1, 8, 1 },
+    { "manyspheres", 640, 360, 4, 4, 4 },
+    { "meshTest",    640, 360, 4, 4, 4 },
+};
+
+// Heap allocations made through operator new, counted per phase
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t bytes) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(bytes ? bytes : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// Sent from the child through a pipe
+struct Result {
+    bool ok = false;
+    double parse = 0, mesh = 0, build = 0, render = 0, write = 0;
+    uint64_t rays = 0;
+    long peakKB = 0;
+    uint64_t loadAllocs = 0, buildAllocs = 0;
+
+    double total() const { return parse + mesh + build + render + write; }
+    double mrays() const { return render > 0 ? rays / render / 1e6 : 0; }
+};
+
+static double since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Result runScene(const BenchScene& b, const std::string& outDir) {
+    Result r;
+    RenderConfig config;
+    config.samplesPerPixel = b.spp;
+    config.shadowSamples = b.shadowSamples;
+    config.glossySamples = b.glossySamples;
+    config.inputScene = std::string("../ASCII/") + b.name + ".txt";
+    config.outputImage = outDir + "/" + b.name + ".ppm";
+
+    Camera cam;
+    Scene scene;
+    uint64_t allocs = allocations;
+    auto start = std::chrono::steady_clock::now();
+    if (!loadScene(config.inputScene, cam, scene)) return r;
+    r.mesh = scene.meshSeconds;
+    r.parse = since(start) - r.mesh;
+    r.loadAllocs = allocations - allocs;
+    cam.resolutionX = b.width;
+    cam.resolutionY = b.height;
+
+    // Single-threaded binned builds so the tree is the same on every machine
+    allocs = allocations;
+    start = std::chrono::steady_clock::now();
+    RenderConfig build = config;
+    build.buildThreads = 1;
+    build.bvhBuild = BVHBuildMode::Binned;
+    build.bvhLayout = BVHLayout::Full;
+    build.lazyBVH = false;
+    build.accel = AccelType::BVH;
+    build.useBVH = true;
+    Shape* accel = buildAcceleration(scene, build);
+    r.build = since(start);
+    r.buildAllocs = allocations - allocs;
+
+    Raytracer tracer(&cam, &scene, accel, config);
+    Image img(cam.resolutionX, cam.resolutionY);
+    Stats::reset();
+    start = std::chrono::steady_clock::now();
+    tracer.render(img);
+    r.render = since(start);
+
+    uint64_t counts[STAT_COUNT];
+    Stats::merge(counts);
+    r.rays = counts[STAT_PRIMARY_RAYS] + counts[STAT_SHADOW_RAYS] + counts[STAT_REFLECTION_RAYS]
+           + counts[STAT_REFRACTION_RAYS] + counts[STAT_GLOSSY_RAYS];
+
+    start = std::chrono::steady_clock::now();
+    if (!img.writePPM(config.outputImage)) return r;
+    r.write = since(start);
+
+    delete accel;
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    r.peakKB = usage.ru_maxrss;     // kilobytes on Linux
+    r.ok = true;
+    return r;
+}
+
+static Result runIsolated(const BenchScene& b, const std::string& outDir) {
+    Result r;
+    int fds[2];
+    if (pipe(fds) != 0) return r;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        std::cout.rdbuf(nullptr);       // progress bar and image messages
+        Result child = runScene(b, outDir);
+        ssize_t written = write(fds[1], &child, sizeof(child));
+        _exit(written == (ssize_t)sizeof(child) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    if (pid > 0 && read(fds[0], &r, sizeof(r)) != (ssize_t)sizeof(r)) r.ok = false;
+    close(fds[0]);
+    if (pid > 0) waitpid(pid, nullptr, 0);
+    return r;
+}
+
+static const char* HEADER = "scene,width,height,spp,parse_s,mesh_s,build_s,render_s,write_s,total_s,rays,mrays_per_s,peak_rss_kb,load_allocs,build_allocs";
+
+static bool writeCSV(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    out << HEADER << "\n" << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchScene& b = SCENES[i];
+        const Result& r = results[i];
+        out << b.name << "," << b.width << "," << b.height << "," << b.spp << ","
+            << r.parse << "," << r.mesh << "," << r.build << "," << r.render << "," << r.write << ","
+            << r.total() << "," << r.rays << "," << r.mrays() << "," << r.peakKB << ","
+            << r.loadAllocs << "," << r.buildAllocs << "\n";
+    }
+    return true;
+}
+
+// Baseline rows keyed by scene name, columns as in HEADER
+static std::map<std::string, Result> readCSV(const std::string& path) {
+    std::map<std::string, Result> rows;
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        std::vector<std::string> f;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) f.push_back(field);
+        if (f.size() != 13 && f.size() != 15) continue;     // older baselines have no allocation counts
+
+        Result r;
+        r.parse = std::stod(f[4]);
+        r.mesh = std::stod(f[5]);
+        r.build = std::stod(f[6]);
+        r.render = std::stod(f[7]);
+        r.write = std::stod(f[8]);
+        r.rays = std::stoull(f[10]);
+        r.peakKB = std::stol(f[12]);
+        if (f.size() == 15) {
+            r.loadAllocs = std::stoull(f[13]);
+            r.buildAllocs = std::stoull(f[14]);
+        }
+        r.ok = true;
+        rows[f[0]] = r;
+    }
+    return rows;
+}
+
+// Phases shorter than this are timer noise and never fail a run
+static const double MIN_SECONDS = 0.05;
+
+int main(int argc, char* argv[]) {
+    std::string outPath = "Bench/results.csv";
+    std::string baselinePath;
+    std::string imageDir = "Bench/out";
+    double tolerance = 0.15;
+    int repeat = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (strcmp(argv[i], "-baseline") == 0 && i + 1 < argc) baselinePath = argv[++i];
+        else if (strcmp(argv[i], "-images") == 0 && i + 1 < argc) imageDir = argv[++i];
+        else if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc) tolerance = std::atof(argv[++i]);
+        else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) repeat = std::max(1, std::atoi(argv[++i]));
+        else {
+            std::cerr << "Usage: " << argv[0] << " [-o results.csv] [-baseline baseline.csv] [-images dir]"
+                      << " [-tolerance 0.15] [-repeat 5]\n";
+            return 1;
+        }
+    }
+    std::filesystem::create_directories(imageDir);
+
+    // Fastest of the repeats for every phase
+    std::vector<Result> results;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const BenchScene& b : SCENES) {
+        Result best;
+        for (int i = 0; i < repeat; ++i) {
+            Result r = runIsolated(b, imageDir);
+            if (!r.ok) {
+                std::cerr << "Benchmark failed on " << b.name << "\n";
+                return 1;
+            }
+            if (i == 0) {
+                best = r;
+                continue;
+            }
+            best.parse = std::min(best.parse, r.parse);
+            best.mesh = std::min(best.mesh, r.mesh);
+            best.build = std::min(best.build, r.build);
+            best.render = std::min(best.render, r.render);
+            best.write = std::min(best.write, r.write);
+            best.peakKB = std::min(best.peakKB, r.peakKB);
+        }
+        results.push_back(best);
+
+        std::cout << std::left << std::setw(12) << b.name << std::right
+                  << "  parse " << best.parse << "  mesh " << best.mesh << "  build " << best.build
+                  << "  render " << best.render << "  write " << best.write << " s  "
+                  << best.mrays() << " Mrays/s  " << best.peakKB / 1024.0 << " MB  "
+                  << best.loadAllocs << "+" << best.buildAllocs << " allocs\n";
+    }
+
+    if (!writeCSV(outPath, results)) {
+        std::cerr << "Failed to write " << outPath << "\n";
+        return 1;
+    }
+    std::cout << "Results written to " << outPath << "\n";
+
+    if (baselinePath.empty()) return 0;
+
+    std::map<std::string, Result> baseline = readCSV(baselinePath);
+    if (baseline.empty()) {
+        std::cerr << "No baseline in " << baselinePath << ", run make bench-baseline\n";
+        return 1;
+    }
+
+    int failures = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const char* name = SCENES[i].name;
+        auto it = baseline.find(name);
+        if (it == baseline.end()) {
+            std::cout << name << ": not in baseline\n";
+            continue;
+        }
+        const Result& now = results[i];
+        const Result& base = it->second;
+
+        // A different ray count means the workload changed, not the speed
+        if (now.rays != base.rays) {
+            std::cout << name << ": ray count " << now.rays << " vs baseline " << base.rays << "\n";
+        }
+
+        auto check = [&](const char* what, double n, double b, double floor) {
+            if (b < floor || n <= b * (1.0 + tolerance)) return;
+            std::cout << name << ": " << what << " " << n << " vs baseline " << b
+                      << " (+" << (n / b - 1.0) * 100.0 << "%)\n";
+            failures++;
+        };
+        check("build s", now.build, base.build, MIN_SECONDS);
+        check("render s", now.render, base.render, MIN_SECONDS);
+        check("peak RSS KB", (double)now.peakKB, (double)base.peakKB, 0.0);
+        check("load allocs", (double)now.loadAllocs, (double)base.loadAllocs, 1.0);
+        check("build allocs", (double)now.buildAllocs, (double)base.buildAllocs, 1.0);
+    }
+
+    if (failures > 0) {
+        std::cerr << "Benchmark regressed against " << baselinePath << "\n";
+        return 1;
+    }
+    std::cout << "No regressions against " << baselinePath << " (tolerance " << tolerance * 100.0 << "%)\n";
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include "../raytracer.h"
+#include "../scene.h"
+#include "../image.h"
+#include "../accel.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <algorithm>
+
+// Equal-time convergence: error against a cached reference versus wall-clock
+// The configured renderer runs full-frame passes until each time budget is
+// spent; the running mean of the passes is compared to the reference.
+// Usage: ./Bench/converge [-spp 4] [--shadow-samples 4] [--glossy-samples 4]
+//                         [-budgets 0.25,0.5,1,2] [-w W -h H] [-o out.csv] [scene...]
+
+static const char* DEFAULT_SCENES[] = { "Test1", "softshadows", "shiny", "glass", "texture" };
+
+// Reference quality, rendered once per scene and size
+// Glossy rays branch at every bounce, so passes are kept cheap and many
+static const int REF_SPP = 4;
+static const int REF_SHADOW = 16;
+static const int REF_GLOSSY = 4;
+static const int REF_PASSES = 32;
+
+// Camera samples are seeded from config.seed and the pixel, so every pass
+// needs its own seed. Reference passes start far from the measured ones.
+static const uint64_t REF_SEED = 0x5EED0000;
+
+struct Options {
+    RenderConfig config;
+    std::vector<double> budgets = { 0.25, 0.5, 1.0, 2.0 };
+    std::vector<std::string> scenes;
+    std::string outPath = "Bench/convergence.csv";
+    std::string refDir = "Bench/reference";
+    bool rebuildReference = false;
+};
+
+// Silences the progress bar while alive
+struct Quiet {
+    std::streambuf* saved = std::cout.rdbuf(nullptr);
+    ~Quiet() {
+        std::cout.rdbuf(saved);
+        std::cout.clear();
+    }
+};
+
+struct Loaded {
+    Camera cam;
+    Scene scene;
+    Shape* accel = nullptr;
+
+    ~Loaded() {
+        delete accel;
+    }
+};
+
+static bool load(const std::string& name, const Options& opt, Loaded& out) {
+    Quiet quiet;
+    if (!loadScene("../ASCII/" + name + ".txt", out.cam, out.scene)) return false;
+    out.cam.resolutionX = opt.config.width;
+    out.cam.resolutionY = opt.config.height;
+
+    RenderConfig build = opt.config;
+    build.buildThreads = 1;
+    out.accel = buildAcceleration(out.scene, build);
+    return true;
+}
+
+// Mean of several high-quality passes, cached as RGB PFM
+static bool reference(const std::string& name, const Options& opt, Loaded& l, std::vector<Vector3>& ref) {
+    int w = l.cam.resolutionX, h = l.cam.resolutionY;
+    std::string path = opt.refDir + "/" + name + "_" + std::to_string(w) + "x" + std::to_string(h)
+                     + "_seed" + std::to_string(REF_SEED) + ".pfm";
+
+    std::vector<float> values;
+    int fw, fh, channels;
+    if (!opt.rebuildReference && readPFM(path, values, fw, fh, channels) && fw == w && fh == h && channels == 3) {
+        ref.resize((size_t)w * h);
+        for (size_t i = 0; i < ref.size(); ++i) ref[i] = Vector3(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+        return true;
+    }
+
+    RenderConfig config = opt.config;
+    config.samplesPerPixel = REF_SPP;
+    config.shadowSamples = REF_SHADOW;
+    config.glossySamples = REF_GLOSSY;
+    Image img(w, h);
+
+    std::cout << "Rendering reference " << path << "..." << std::flush;
+    auto start = std::chrono::steady_clock::now();
+    ref.assign((size_t)w * h, Vector3(0, 0, 0));
+    std::vector<Vector3> pass;
+    for (int p = 0; p < REF_PASSES; ++p) {
+        Quiet quiet;
+        config.seed = REF_SEED + p;
+        Raytracer tracer(&l.cam, &l.scene, l.accel, config);
+        tracer.render(img, pass);
+        for (size_t i = 0; i < ref.size(); ++i) ref[i] = ref[i] + pass[i] / (float)REF_PASSES;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << " " << std::defaultfloat << elapsed.count() << " s\n";
+
+    values.resize(ref.size() * 3);
+    for (size_t i = 0; i < ref.size(); ++i) {
+        values[3 * i] = ref[i].x;
+        values[3 * i + 1] = ref[i].y;
+        values[3 * i + 2] = ref[i].z;
+    }
+    std::filesystem::create_directories(opt.refDir);
+    if (!writePFM(path, values, w, h, 3)) std::cerr << "Failed to cache " << path << "\n";
+    return true;
+}
+
+// RMSE and relative MSE after exposure, over all pixels and channels
+static void error(const std::vector<Vector3>& mean, const std::vector<Vector3>& ref, float exposure,
+                  double& rmse, double& relMSE) {
+    double se = 0, rel = 0;
+    for (size_t i = 0; i < ref.size(); ++i) {
+        const float a[3] = { mean[i].x * exposure, mean[i].y * exposure, mean[i].z * exposure };
+        const float r[3] = { ref[i].x * exposure, ref[i].y * exposure, ref[i].z * exposure };
+        for (int c = 0; c < 3; ++c) {
+            double d = (double)a[c] - r[c];
+            se += d * d;
+            rel += d * d / ((double)r[c] * r[c] + 1e-2);
+        }
+    }
+    size_t n = ref.size() * 3;
+    rmse = std::sqrt(se / n);
+    relMSE = rel / n;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    opt.config.width = 160;
+    opt.config.height = 90;
+    opt.config.samplesPerPixel = 4;
+    opt.config.shadowSamples = 4;
+    opt.config.glossySamples = 4;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-spp" && i + 1 < argc) opt.config.samplesPerPixel = std::atoi(argv[++i]);
+        else if (arg == "--shadow-samples" && i + 1 < argc) opt.config.shadowSamples = std::atoi(argv[++i]);
+        else if (arg == "--glossy-samples" && i + 1 < argc) opt.config.glossySamples = std::atoi(argv[++i]);
+        else if (arg == "-w" && i + 1 < argc) opt.config.width = std::atoi(argv[++i]);
+        else if (arg == "-h" && i + 1 < argc) opt.config.height = std::atoi(argv[++i]);
+        else if (arg == "-o" && i + 1 < argc) opt.outPath = argv[++i];
+        else if (arg == "-rebuild-ref") opt.rebuildReference = true;
+        else if (arg == "-budgets" && i + 1 < argc) {
+            opt.budgets.clear();
+            std::stringstream ss(argv[++i]);
+            std::string b;
+            while (std::getline(ss, b, ',')) opt.budgets.push_back(std::atof(b.c_str()));
+            std::sort(opt.budgets.begin(), opt.budgets.end());
+        }
+        else if (arg[0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [-spp N] [--shadow-samples N] [--glossy-samples N]"
+                      << " [-budgets 0.25,0.5,1,2] [-w W -h H] [-o out.csv] [-rebuild-ref] [scene...]\n";
+            return 1;
+        }
+        else opt.scenes.push_back(arg);
+    }
+    if (opt.scenes.empty()) opt.scenes.assign(std::begin(DEFAULT_SCENES), std::end(DEFAULT_SCENES));
+    if (opt.budgets.empty()) return 1;
+
+    std::ofstream csv(opt.outPath);
+    csv << "scene,spp,shadow_samples,glossy_samples,budget_s,seconds,passes,rmse,relmse\n";
+
+    std::cout << "Config: spp " << opt.config.samplesPerPixel << ", shadow " << opt.config.shadowSamples
+              << ", glossy " << opt.config.glossySamples << " at " << opt.config.width << "x" << opt.config.height << "\n";
+
+    for (const std::string& name : opt.scenes) {
+        Loaded l;
+        std::vector<Vector3> ref;
+        if (!load(name, opt, l) || !reference(name, opt, l, ref)) {
+            std::cerr << "Failed to load " << name << "\n";
+            return 1;
+        }
+
+        RenderConfig passConfig = opt.config;
+        Image img(l.cam.resolutionX, l.cam.resolutionY);
+        std::vector<Vector3> sum(ref.size(), Vector3(0, 0, 0)), pass, mean(ref.size());
+
+        std::cout << "\n" << name << "\n" << std::setw(10) << "budget s" << std::setw(10) << "seconds"
+                  << std::setw(8) << "passes" << std::setw(14) << "RMSE" << std::setw(14) << "relMSE" << "\n";
+
+        // Passes until each budget is spent; a budget shorter than one pass
+        // still gets one, the actual time is reported next to it
+        auto start = std::chrono::steady_clock::now();
+        int passes = 0;
+        for (double budget : opt.budgets) {
+            double seconds;
+            do {
+                {
+                    Quiet quiet;
+                    passConfig.seed = opt.config.seed + passes;
+                    Raytracer tracer(&l.cam, &l.scene, l.accel, passConfig);
+                    tracer.render(img, pass);
+                }
+                for (size_t i = 0; i < sum.size(); ++i) sum[i] = sum[i] + pass[i];
+                passes++;
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (seconds < budget);
+
+            for (size_t i = 0; i < sum.size(); ++i) mean[i] = sum[i] / (float)passes;
+            double rmse, relMSE;
+            error(mean, ref, opt.config.exposure, rmse, relMSE);
+
+            std::cout << std::fixed << std::setprecision(2) << std::setw(10) << budget << std::setw(10) << seconds
+                      << std::setw(8) << passes << std::scientific << std::setprecision(3)
+                      << std::setw(14) << rmse << std::setw(14) << relMSE << "\n";
+            csv << name << "," << opt.config.samplesPerPixel << "," << opt.config.shadowSamples << ","
+                << opt.config.glossySamples << "," << budget << "," << seconds << "," << passes << ","
+                << rmse << "," << relMSE << "\n";
+        }
+    }
+
+    std::cout << "\nResults written to " << opt.outPath << "\n";
+    return 0;
+}
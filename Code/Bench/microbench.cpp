@@ -0,0 +1,314 @@
+#include "../raytracer.h"
+#include "../scene.h"
+#include "../accel.h"
+#include "../bvh_builder.h"
+#include "../shapes/sphere.h"
+#include "../shapes/sphereset.h"
+#include "../shapes/cube.h"
+#include "../shapes/plane.h"
+#include "../shapes/triangle.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+// Times the hot kernels one at a time on rays drawn from real scene geometry
+// Each kernel runs warmup batches, then timed batches; the median is reported
+// Usage: ./Bench/microbench [-n ops] [-reps N] [-warmup N] [-i scene]... [filter]
+
+static std::mt19937 rng(42);
+static volatile uint64_t sink;      // keeps results alive past the optimiser
+
+static float uniform(float a, float b) {
+    return std::uniform_real_distribution<float>(a, b)(rng);
+}
+
+static Vector3 pointIn(const AABB& box) {
+    return Vector3(uniform(box.min.x, box.max.x), uniform(box.min.y, box.max.y), uniform(box.min.z, box.max.z));
+}
+
+static Vector3 unit(Vector3 v) {
+    v.normalize();
+    return v;
+}
+
+static Vector3 unitVector() {
+    Vector3 v;
+    do {
+        v = Vector3(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1));
+    } while (v.length() > 1.0f || v.length() < 1e-3f);
+    return unit(v);
+}
+
+// Ray from outside the box towards a random point inside it
+// Roughly what a BVH leaf sees: mostly near misses and hits
+static Ray rayAt(const AABB& box) {
+    Vector3 target = pointIn(box);
+    float reach = std::max((box.max - box.min).length(), 1e-3f) * 2.0f;
+    Vector3 origin = box.centre() + unitVector() * reach;
+    return Ray(origin, unit(target - origin));
+}
+
+struct Options {
+    size_t ops = 100000;
+    int reps = 15;
+    int warmup = 3;
+    std::vector<std::string> scenes;
+    std::string filter;
+};
+
+struct Timing {
+    double median = 0, best = 0, spread = 0;    // ns per op, spread is stddev / mean in %
+    double hitRate = -1;
+};
+
+// batch() runs every op once and returns a count of hits (or any checksum)
+template <typename F>
+static Timing measure(F&& batch, size_t ops, const Options& opt, bool reportHits) {
+    uint64_t hits = 0;
+    for (int i = 0; i < opt.warmup; ++i) hits = batch();
+
+    std::vector<double> ns;
+    for (int i = 0; i < opt.reps; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        hits = batch();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        ns.push_back(elapsed.count() / ops);
+        sink = sink + hits;
+    }
+
+    Timing t;
+    std::sort(ns.begin(), ns.end());
+    t.median = ns[ns.size() / 2];
+    t.best = ns.front();
+    double mean = 0, var = 0;
+    for (double v : ns) mean += v;
+    mean /= ns.size();
+    for (double v : ns) var += (v - mean) * (v - mean);
+    t.spread = mean > 0 ? 100.0 * std::sqrt(var / ns.size()) / mean : 0;
+    if (reportHits) t.hitRate = 100.0 * hits / ops;
+    return t;
+}
+
+static void report(const std::string& name, const Timing& t) {
+    std::cout << std::left << std::setw(32) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(10) << t.median
+              << std::setw(10) << t.best
+              << std::setprecision(1) << std::setw(7) << t.spread << "%"
+              << std::setprecision(2) << std::setw(10) << 1e3 / t.median;
+    if (t.hitRate >= 0) std::cout << std::setprecision(1) << std::setw(8) << t.hitRate << "%";
+    std::cout << "\n";
+}
+
+static bool selected(const Options& opt, const std::string& name) {
+    return opt.filter.empty() || name.find(opt.filter) != std::string::npos;
+}
+
+// Rays paired with the primitive they were aimed at
+struct Job {
+    const Shape* shape;
+    Ray ray;
+};
+
+static void runShapes(const Options& opt, const std::string& name, const std::vector<const Shape*>& shapes) {
+    if (shapes.empty() || !selected(opt, name)) return;
+
+    std::vector<Job> jobs;
+    jobs.reserve(opt.ops);
+    for (size_t i = 0; i < opt.ops; ++i) {
+        const Shape* s = shapes[i % shapes.size()];
+        jobs.push_back({ s, rayAt(s->bounds()) });
+    }
+
+    Timing t = measure([&] {
+        uint64_t hits = 0;
+        for (const Job& j : jobs) {
+            HitInfo hit;
+            hits += j.shape->intersect(j.ray, hit);
+        }
+        return hits;
+    }, jobs.size(), opt, true);
+    report(name, t);
+}
+
+static void runBoxes(const Options& opt, const std::vector<AABB>& boxes) {
+    if (boxes.empty() || !selected(opt, "AABB::intersect")) return;
+
+    std::vector<std::pair<AABB, Ray>> jobs;
+    jobs.reserve(opt.ops);
+    for (size_t i = 0; i < opt.ops; ++i) {
+        const AABB& b = boxes[i % boxes.size()];
+        jobs.push_back({ b, rayAt(b) });
+    }
+
+    Timing t = measure([&] {
+        uint64_t hits = 0;
+        for (const auto& j : jobs) hits += j.first.intersect(j.second, INFINITY);
+        return hits;
+    }, jobs.size(), opt, true);
+    report("AABB::intersect", t);
+}
+
+// Closest-hit camera rays and the renderer's shadow rays through a built BVH
+static void runScene(const Options& opt, const std::string& label, Scene& scene, const Camera& cam) {
+    BVHNode* bvh = BVHBuilder(1).build(scene.shapes);
+
+    std::vector<Ray> primary;
+    primary.reserve(opt.ops);
+    for (size_t i = 0; i < opt.ops; ++i) {
+        float px = uniform(0.0f, (float)cam.resolutionX);
+        float py = uniform(0.0f, (float)cam.resolutionY);
+        primary.push_back(cam.pixelToRay(px, py, 0, 0, 1));
+    }
+
+    // Shadow rays from primary hits to a light, as in computeShadowFactor
+    std::vector<std::pair<Ray, float>> shadow;
+    for (const Ray& r : primary) {
+        if (scene.lights.empty()) break;
+        HitInfo hit;
+        if (!bvh->intersect(r, hit)) continue;
+        const Light& light = scene.lights[shadow.size() % scene.lights.size()];
+        Vector3 L = light.position - hit.point;
+        float dist = L.length();
+        Vector3 n = unit(hit.normal);
+        shadow.push_back({ Ray(hit.point + n * 0.001f, unit(L)), dist });
+    }
+
+    std::string name = "BVH closest (" + label + ")";
+    if (selected(opt, name)) {
+        report(name, measure([&] {
+            uint64_t hits = 0;
+            for (const Ray& r : primary) {
+                HitInfo hit;
+                hits += bvh->intersect(r, hit);
+            }
+            return hits;
+        }, primary.size(), opt, true));
+    }
+
+    name = "BVH shadow (" + label + ")";
+    if (!shadow.empty() && selected(opt, name)) {
+        report(name, measure([&] {
+            uint64_t blocked = 0;
+            for (const auto& s : shadow) {
+                HitInfo hit;
+                blocked += bvh->intersect(s.first, hit) && hit.t < s.second;
+            }
+            return blocked;
+        }, shadow.size(), opt, true));
+    }
+
+    delete bvh;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) opt.ops = std::max(1, std::atoi(argv[++i]));
+        else if (strcmp(argv[i], "-reps") == 0 && i + 1 < argc) opt.reps = std::max(1, std::atoi(argv[++i]));
+        else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc) opt.warmup = std::max(0, std::atoi(argv[++i]));
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) opt.scenes.push_back(argv[++i]);
+        else if (argv[i][0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [-n ops] [-reps N] [-warmup N] [-i scene]... [filter]\n";
+            return 1;
+        }
+        else opt.filter = argv[i];
+    }
+
+    // Cubes, planes and spheres, plus a triangle mesh
+    if (opt.scenes.empty()) opt.scenes = { "../ASCII/reflection.txt", "../ASCII/meshTest.txt" };
+
+    std::vector<Scene*> scenes(opt.scenes.size());
+    std::vector<Camera> cams(opt.scenes.size());
+    std::vector<const Shape*> spheres, sets, cubes, planes, triangles;
+    std::vector<AABB> boxes;
+
+    for (size_t i = 0; i < opt.scenes.size(); ++i) {
+        scenes[i] = new Scene();
+        if (!loadScene(opt.scenes[i], cams[i], *scenes[i])) {
+            std::cerr << "Failed to load " << opt.scenes[i] << "\n";
+            return 1;
+        }
+
+        // Instances need their mesh BVH for bounds
+        RenderConfig build;
+        build.buildThreads = 1;
+        buildMeshBVHs(*scenes[i], build);
+
+        for (const Shape* s : scenes[i]->shapes) {
+            boxes.push_back(s->bounds());
+            if (auto* set = dynamic_cast<const SphereSet*>(s)) {
+                sets.push_back(set);
+                for (int k = 0; k < set->count; ++k) spheres.push_back(set->spheres[k]);
+            }
+            else if (dynamic_cast<const Sphere*>(s)) spheres.push_back(s);
+            else if (dynamic_cast<const Cube*>(s)) cubes.push_back(s);
+            else if (dynamic_cast<const Plane*>(s)) planes.push_back(s);
+        }
+        for (auto& m : scenes[i]->meshes) {
+            for (const Shape* t : m.second->triangles) {
+                triangles.push_back(t);
+                boxes.push_back(t->bounds());
+            }
+        }
+    }
+
+    std::cout << opt.ops << " ops per batch, " << opt.warmup << " warmup + " << opt.reps << " timed batches\n\n";
+    std::cout << std::left << std::setw(32) << "kernel" << std::right << std::setw(10) << "ns/op"
+              << std::setw(10) << "best" << std::setw(8) << "+-" << std::setw(10) << "Mops/s"
+              << std::setw(9) << "hits" << "\n";
+
+    runBoxes(opt, boxes);
+    runShapes(opt, "Sphere::intersect", spheres);
+    runShapes(opt, "SphereSet::intersect", sets);
+    runShapes(opt, "Cube::intersect", cubes);
+    runShapes(opt, "Plane::intersect", planes);
+    runShapes(opt, "Triangle::intersect", triangles);
+
+    for (size_t i = 0; i < scenes.size(); ++i) {
+        std::string label = opt.scenes[i].substr(opt.scenes[i].find_last_of("/\\") + 1);
+        label = label.substr(0, label.find_last_of('.'));
+        runScene(opt, label, *scenes[i], cams[i]);
+    }
+
+    // Ray generation on the first scene's camera
+    const Camera& cam = cams[0];
+    if (selected(opt, "Camera::pixelToRay")) {
+        std::vector<std::pair<float, float>> pixels(opt.ops);
+        for (auto& p : pixels) p = { uniform(0.0f, (float)cam.resolutionX), uniform(0.0f, (float)cam.resolutionY) };
+
+        report("Camera::pixelToRay", measure([&] {
+            float sum = 0.0f;
+            for (const auto& p : pixels) sum += cam.pixelToRay(p.first, p.second, 0, 0, 1).direction.x;
+            return (uint64_t)(sum != 0.0f);
+        }, pixels.size(), opt, false));
+    }
+
+    // Tone mapping on HDR colours up to 4
+    std::vector<Vector3> colours(opt.ops);
+    for (auto& c : colours) c = Vector3(uniform(0, 4), uniform(0, 4), uniform(0, 4));
+
+    if (selected(opt, "reinhardToneMapping")) {
+        report("reinhardToneMapping", measure([&] {
+            float sum = 0.0f;
+            for (const Vector3& c : colours) sum += reinhardToneMapping(c).x;
+            return (uint64_t)(sum != 0.0f);
+        }, colours.size(), opt, false));
+    }
+    if (selected(opt, "acesToneMapping")) {
+        report("acesToneMapping", measure([&] {
+            float sum = 0.0f;
+            for (const Vector3& c : colours) sum += acesToneMapping(c).x;
+            return (uint64_t)(sum != 0.0f);
+        }, colours.size(), opt, false));
+    }
+
+    for (Scene* s : scenes) delete s;
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "../scene.h"
+#include "../accel.h"
+#include "../raycapture.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// Replays rays captured with --capture-rays through a chosen accelerator
+// Closest-hit queries must find the distance the render found; any-hit
+// queries (shadow rays only) must agree on occlusion.
+// Usage: ./Bench/replay -i scene.txt -rays rays.bin [-accel median|binned|sbvh|compact|lazy|grid|none]
+//                       [-query closest|any] [-reps N]
+
+struct Options {
+    std::string scene;
+    std::string rays;
+    RenderConfig config;        // accelerator choice, built by buildAcceleration like a render
+    bool anyHit = false;
+    int reps = 3;
+};
+
+// Brute force over the shapes when there is no accelerator
+struct ShapeList : public Shape {
+    const std::vector<Shape*>& shapes;
+    explicit ShapeList(const std::vector<Shape*>& s) : shapes(s) {}
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        bool found = false;
+        for (const Shape* s : shapes) found |= s->intersect(ray, hit);
+        return found;
+    }
+    AABB bounds() const override { return AABB(); }
+    Vector3 centroid() const override { return Vector3(0, 0, 0); }
+};
+
+// Shapes have no dedicated any-hit query; clipping t to the light distance
+// lets traversal skip everything behind it, as a shadow query would
+static bool query(const Shape* accel, const CapturedRay& c, bool anyHit, float& t) {
+    HitInfo hit;
+    if (anyHit) hit.t = c.tMax;
+    accel->intersect(c.ray(), hit);
+    t = hit.t;
+    return anyHit ? hit.hit : t < c.tMax;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    opt.config.buildThreads = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-i" && i + 1 < argc) opt.scene = argv[++i];
+        else if (arg == "-rays" && i + 1 < argc) opt.rays = argv[++i];
+        else if (arg == "-reps" && i + 1 < argc) opt.reps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-query" && i + 1 < argc) opt.anyHit = std::string(argv[++i]) == "any";
+        else if (arg == "-accel" && i + 1 < argc) {
+            std::string a = argv[++i];
+            if (a == "median") opt.config.bvhBuild = BVHBuildMode::Median;
+            else if (a == "binned") opt.config.bvhBuild = BVHBuildMode::Binned;
+            else if (a == "sbvh") opt.config.bvhBuild = BVHBuildMode::Spatial;
+            else if (a == "compact") opt.config.bvhLayout = BVHLayout::Compact;
+            else if (a == "lazy") opt.config.lazyBVH = true;
+            else if (a == "grid") opt.config.accel = AccelType::Grid;
+            else if (a == "none") opt.config.useBVH = false;
+            else {
+                std::cerr << "Unknown accelerator: " << a << "\n";
+                return 1;
+            }
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " -i scene.txt -rays rays.bin [-accel median|binned|sbvh|compact|lazy|grid|none]"
+                      << " [-query closest|any] [-reps N]\n";
+            return 1;
+        }
+    }
+    if (opt.scene.empty() || opt.rays.empty()) {
+        std::cerr << "Need a scene (-i) and a capture (-rays)\n";
+        return 1;
+    }
+
+    std::vector<CapturedRay> rays;
+    if (!RayCapture::read(opt.rays, rays)) {
+        std::cerr << "Failed to read captured rays from " << opt.rays << "\n";
+        return 1;
+    }
+
+    Camera cam;
+    Scene scene;
+    if (!loadScene(opt.scene, cam, scene)) return 1;
+
+    // The chosen accelerator for the mesh BVHs and the top level
+    auto start = std::chrono::steady_clock::now();
+    Shape* accel = buildAcceleration(scene, opt.config);
+    if (!accel) accel = new ShapeList(scene.shapes);
+    std::chrono::duration<double> build = std::chrono::steady_clock::now() - start;
+    std::cout << "Build: " << build.count() << " s\n";
+
+    // Rays grouped by type, in capture order within a type
+    // Any-hit queries only make sense for shadow rays
+    std::vector<std::vector<CapturedRay>> byType(RAY_TYPES);
+    for (const CapturedRay& c : rays) {
+        if (c.type >= RAY_TYPES) continue;
+        if (opt.anyHit && c.type != RAY_SHADOW) continue;
+        byType[c.type].push_back(c);
+    }
+
+    std::cout << std::left << std::setw(12) << "type" << std::right << std::setw(12) << "rays"
+              << std::setw(12) << "Mrays/s" << std::setw(12) << "mismatches" << "\n";
+
+    size_t totalRays = 0, totalMismatches = 0;
+    double totalSeconds = 0;
+    for (int type = 0; type < RAY_TYPES; ++type) {
+        const std::vector<CapturedRay>& set = byType[type];
+        if (set.empty()) continue;
+
+        // Fastest repetition, results checked on the first
+        double best = INFINITY;
+        size_t mismatches = 0;
+        for (int r = 0; r < opt.reps; ++r) {
+            auto t0 = std::chrono::steady_clock::now();
+            for (const CapturedRay& c : set) {
+                float t;
+                bool hit = query(accel, c, opt.anyHit, t);
+                if (r > 0) continue;
+                bool expected = c.tHit < c.tMax;
+                if (opt.anyHit ? hit != expected : t != c.tHit) mismatches++;
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+            best = std::min(best, elapsed.count());
+        }
+
+        std::cout << std::left << std::setw(12) << RayCapture::typeName(type) << std::right
+                  << std::setw(12) << set.size() << std::setw(12) << std::fixed << std::setprecision(2)
+                  << set.size() / best / 1e6 << std::setw(12) << mismatches << "\n";
+        totalRays += set.size();
+        totalMismatches += mismatches;
+        totalSeconds += best;
+    }
+
+    std::cout << std::left << std::setw(12) << "all" << std::right << std::setw(12) << totalRays
+              << std::setw(12) << (totalSeconds > 0 ? totalRays / totalSeconds / 1e6 : 0.0)
+              << std::setw(12) << totalMismatches << "\n";
+
+    delete accel;
+    if (totalMismatches > 0) {
+        std::cerr << "Replay results differ from the captured render\n";
+        return 1;
+    }
+    return 0;
+}
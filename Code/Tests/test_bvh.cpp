@@ -0,0 +1,97 @@
+#include "../bvh_builder.h"
+#include "../shapes/sphereset.h"
+#include <iostream>
+#include <vector>
+
+// Closest hit by testing every shape
+static HitInfo bruteForce(const std::vector<Shape*>& shapes, const Ray& ray) {
+    HitInfo hit;
+    for (Shape* s : shapes) {
+        s->intersect(ray, hit);
+    }
+    return hit;
+}
+
+// Fire random rays and count hits that differ from brute force
+static int countMismatches(const std::vector<Shape*>& shapes, const Shape* bvh) {
+    int mismatches = 0;
+    for (int i = 0; i < 2000; i++) {
+        Vector3 origin(randomFloat() * 40.0f - 20.0f, randomFloat() * 40.0f - 20.0f, -30.0f);
+        Vector3 dir(randomFloat() - 0.5f, randomFloat() - 0.5f, 1.0f);
+        dir.normalize();
+        Ray ray(origin, dir);
+
+        HitInfo expected = bruteForce(shapes, ray);
+        HitInfo actual;
+        bvh->intersect(ray, actual);
+
+        if (expected.hit != actual.hit || (expected.hit && expected.shape != actual.shape)) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main() {
+    // 20x20 grid of spheres, the first row packed into sets
+    std::vector<Sphere*> spheres;
+    std::vector<Shape*> shapes;
+    for (int y = 0; y < 20; y++) {
+        for (int x = 0; x < 20; x++) {
+            spheres.push_back(new UniformSphere(Vector3(x * 2.0f - 19.0f, y * 2.0f - 19.0f, 0.0f),
+                                                Vector3(0, 0, 0), Vector3(0.6f, 0.6f, 0.6f)));
+        }
+    }
+    for (int i = 0; i < 16; i += SphereSet::WIDTH) {
+        shapes.push_back(new SphereSet(&spheres[i], SphereSet::WIDTH));
+    }
+    for (size_t i = 16; i < spheres.size(); i++) {
+        shapes.push_back(spheres[i]);
+    }
+
+    BVHBuilder builder(1);
+    BVHNode* bvh = builder.build(shapes);
+    std::cout << "Built BVH over " << shapes.size() << " shapes, SAH cost " << bvh->cost << std::endl;
+
+    int failures = countMismatches(shapes, bvh);
+    std::cout << "Mismatches after build: " << failures << std::endl;
+
+    // Nudge every sphere: refit alone should keep the tree usable
+    for (Sphere* s : spheres) {
+        s->translation = s->translation + Vector3(0.1f, -0.1f, 0.0f);
+    }
+    size_t rebuilt = builder.update(bvh);
+    int mismatches = countMismatches(shapes, bvh);
+    failures += mismatches;
+    std::cout << "Small move: rebuilt " << rebuilt << " shapes, SAH cost " << bvh->cost
+              << ", mismatches " << mismatches << std::endl;
+
+    // Mirror spheres in one corner, including packed ones, and grow them
+    for (int y = 0; y < 6; y++) {
+        for (int x = 0; x < 6; x += 2) {
+            Sphere* s = spheres[y * 20 + x];
+            s->translation = Vector3(s->translation.y, s->translation.x, 0.0f);
+            s->scale = Vector3(0.8f, 0.8f, 0.8f);
+        }
+    }
+    rebuilt = builder.update(bvh);
+    mismatches = countMismatches(shapes, bvh);
+    failures += mismatches;
+    std::cout << "Large move: rebuilt " << rebuilt << " shapes, SAH cost " << bvh->cost
+              << " (built " << bvh->buildCost << "), mismatches " << mismatches << std::endl;
+
+    delete bvh;
+    for (int i = 0; i < 16 / SphereSet::WIDTH; i++) {
+        delete shapes[i];
+    }
+    for (Sphere* s : spheres) {
+        delete s;
+    }
+
+    if (failures > 0) {
+        std::cerr << "BVH update test failed" << std::endl;
+        return 1;
+    }
+    std::cout << "BVH update test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "../scene.h"
+#include "../bvh_builder.h"
+#include "../accel.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+// Compares node visits of primary rays through meshTest.txt for the
+// binned and spatial-split builders. Built with RT_STATS for the counter.
+
+struct Pass {
+    std::vector<float> t;           // hit distance per ray, -1 for a miss
+    unsigned long long visits = 0;
+};
+
+static Pass traceScene(Scene& scene, const Camera& cam, bool spatial) {
+
+    // Rebuild every mesh BVH with the chosen builder
+    RenderConfig config;
+    config.buildThreads = 1;
+    config.bvhBuild = spatial ? BVHBuildMode::Spatial : BVHBuildMode::Binned;
+    buildMeshBVHs(scene, config);
+    BVHNode* tlas = BVHBuilder(1).build(scene.shapes);
+
+    Pass result;
+    Stats::reset();
+    for (int y = 0; y < cam.resolutionY; y++) {
+        for (int x = 0; x < cam.resolutionX; x++) {
+            Ray ray = cam.pixelToRay((float)x, (float)y, 0, 0, 1);
+            HitInfo hit;
+            tlas->intersect(ray, hit);
+            result.t.push_back(hit.hit ? hit.t : -1.0f);
+        }
+    }
+    uint64_t counts[STAT_COUNT];
+    Stats::merge(counts);
+    result.visits = counts[STAT_BVH_NODES];
+
+    delete tlas;
+    return result;
+}
+
+int main() {
+    Camera cam;
+    Scene scene;
+    if (!loadScene("../ASCII/meshTest.txt", cam, scene)) {
+        std::cerr << "Failed to load meshTest.txt" << std::endl;
+        return 1;
+    }
+    cam.resolutionX = 320;
+    cam.resolutionY = 180;
+
+    Pass binned = traceScene(scene, cam, false);
+    Pass spatial = traceScene(scene, cam, true);
+
+    double rays = (double)binned.t.size();
+    std::cout << "Binned SAH:    " << binned.visits / rays << " nodes per ray" << std::endl;
+    std::cout << "Spatial split: " << spatial.visits / rays << " nodes per ray" << std::endl;
+    std::cout << "Reduction:     " << 100.0 * (1.0 - (double)spatial.visits / binned.visits) << "%" << std::endl;
+
+    // Both trees must find the same closest hits
+    int mismatches = 0;
+    for (size_t i = 0; i < binned.t.size(); i++) {
+        if (std::abs(binned.t[i] - spatial.t[i]) > 1e-4f) mismatches++;
+    }
+    std::cout << "Hit mismatches: " << mismatches << std::endl;
+
+    if (mismatches > 0) {
+        std::cerr << "SBVH test failed" << std::endl;
+        return 1;
+    }
+    std::cout << "SBVH test passed" << std::endl;
+    return 0;
+}
@@ -26,9 +26,14 @@ struct AABB {
     }
 
     // Expand the AABB to include another AABB
+    // Component-wise, so merging an empty box leaves this one unchanged
     void expand(const AABB& b) {
-        expand(b.min);
-        expand(b.max);
+        min.x = std::min(min.x, b.min.x);
+        min.y = std::min(min.y, b.min.y);
+        min.z = std::min(min.z, b.min.z);
+        max.x = std::max(max.x, b.max.x);
+        max.y = std::max(max.y, b.max.y);
+        max.z = std::max(max.z, b.max.z);
     }
 
     // Expand the AABB to include a single point
@@ -44,6 +49,13 @@ struct AABB {
     // Compute extent
     Vector3 extent() const { return (max - min) * 0.5f; }
 
+    // Surface area, 0 for an empty box
+    float surfaceArea() const {
+        Vector3 e = max - min;
+        if (e.x < 0.0f || e.y < 0.0f || e.z < 0.0f) return 0.0f;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
     // Return longest axis
     int longestAxis() const {
         Vector3 e = max - min;
@@ -0,0 +1,93 @@
+#include "accel.h"
+#include "BVH.h"
+#include "bvh_builder.h"
+#include "compact_bvh.h"
+#include "sbvh_builder.h"
+#include "lazy_bvh.h"
+#include "grid.h"
+#include "trace.h"
+#include "memory.h"
+#include <iostream>
+#include <thread>
+#include <algorithm>
+
+// Build a BVH with the configured builder
+Shape* buildBVH(std::vector<Shape*>& shapes, const RenderConfig& config) {
+    int threads = config.buildThreads;
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Binned top levels, full layout
+    if (config.lazyBVH) {
+        return new LazyBVH(shapes, threads);
+    }
+
+    BVHNode* root;
+    if (config.bvhBuild == BVHBuildMode::Median) {
+        root = new BVHNode(shapes, 0, shapes.size());
+    } else if (config.bvhBuild == BVHBuildMode::Spatial) {
+        SBVHBuilder builder;
+        root = builder.build(shapes);
+        if (builder.references() > shapes.size()) {
+            std::cout << "Spatial splits: " << builder.references() - shapes.size() << " extra references for "
+                      << shapes.size() << " primitives\n";
+        }
+    } else {
+        BVHBuilder builder(threads);
+        root = builder.build(shapes);
+    }
+
+    if (config.bvhLayout == BVHLayout::Compact) {
+        TRACE_SCOPE("compact BVH");
+        CompactBVH* compact = new CompactBVH(root);
+        if (compact->valid) {
+            delete root;
+            return compact;
+        }
+        std::cerr << "BVH too deep for the compact layout, keeping full nodes\n";
+        delete compact;
+    }
+    return root;
+}
+
+// Upper bound on the nodes of a BVH over n primitives, checked against the budget before building
+static size_t bvhEstimate(size_t n) {
+    return 2 * n * sizeof(BVHNode);
+}
+
+void buildMeshBVHs(Scene& scene, const RenderConfig& config) {
+    for (auto& m : scene.meshes) {
+        Memory::check("mesh BVH build", bvhEstimate(m.second->triangles.size()));
+        delete m.second->bvh;
+        m.second->bvh = buildBVH(m.second->triangles, config);
+    }
+}
+
+Shape* buildAcceleration(Scene& scene, const RenderConfig& config, AccelReport* report) {
+    buildMeshBVHs(scene, config);
+    if (report) {
+        for (auto& m : scene.meshes) {
+            report->primitives += m.second->triangles.size();
+            report->bvhBytes += Memory::bvhBytes(m.second->bvh);
+        }
+    }
+
+    if (!config.useBVH || scene.shapes.empty()) return nullptr;
+    if (report) report->primitives += scene.shapes.size();
+
+    if (config.accel == AccelType::Grid) {
+        if (report) std::cout << "Building grid for " << scene.shapes.size() << " primitives...\n";
+        TRACE_SCOPE("grid build");
+        UniformGrid* grid = new UniformGrid(scene.shapes);
+        if (report) {
+            std::cout << "Grid resolution: " << grid->res[0] << "x" << grid->res[1] << "x" << grid->res[2]
+                      << " (" << grid->cellPrims.size() << " references)\n";
+        }
+        return grid;
+    }
+
+    if (report) std::cout << "Building BVH for " << scene.shapes.size() << " primitives...\n";
+    Memory::check("BVH build", bvhEstimate(scene.shapes.size()));
+    Shape* bvh = buildBVH(scene.shapes, config);
+    if (report) report->bvhBytes += Memory::bvhBytes(bvh);
+    return bvh;
+}
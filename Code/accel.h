@@ -0,0 +1,26 @@
+#ifndef ACCEL_H
+#define ACCEL_H
+
+#include "scene.h"
+#include "config.h"
+#include <vector>
+
+// Build a BVH with the configured builder, layout and laziness
+Shape* buildBVH(std::vector<Shape*>& shapes, const RenderConfig& config);
+
+// One BVH per unique mesh, replacing any already built. MeshInstance needs
+// these before bounds() or intersect(), so every Scene consumer calls this
+// (or buildAcceleration) after loadScene.
+void buildMeshBVHs(Scene& scene, const RenderConfig& config);
+
+// What buildAcceleration built, for the command line's progress output
+struct AccelReport {
+    size_t primitives = 0;      // mesh triangles plus top-level shapes
+    size_t bvhBytes = 0;        // mesh BVHs plus the top-level BVH, 0 for a grid
+};
+
+// Mesh BVHs, then the top level over scene.shapes (null without one).
+// With a report, also prints what is being built and fills the report in.
+Shape* buildAcceleration(Scene& scene, const RenderConfig& config, AccelReport* report = nullptr);
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Monotonic bump allocator for objects that live as long as their owner
+// (scene primitives, one arena per type, and BVH nodes). Objects are carved
+// out of large blocks in allocation order and released together; there is
+// no per-object free.
+// Not thread-safe, parallel builders use one arena per thread (NodePool).
+class Arena {
+public:
+    static const size_t BLOCK_BYTES = 1 << 20;
+
+    explicit Arena(size_t blockBytes = BLOCK_BYTES) : blockBytes(blockBytes) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        release();
+    }
+
+    // Object destroyed with the arena, in reverse order of creation
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            destructors.push_back({ obj, [](void* p) { static_cast<T*>(p)->~T(); } });
+        }
+        return obj;
+    }
+
+    // Object whose destructor never runs, for types that own no memory
+    // Freeing the arena is then a handful of free() calls
+    template <typename T, typename... Args>
+    T* makeTrivial(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    void* allocate(size_t bytes, size_t align) {
+        size_t offset = blocks.empty() ? 0 : alignedOffset(align);
+        if (blocks.empty() || offset + bytes > capacity) {
+            grow(bytes + align);
+            offset = alignedOffset(align);
+        }
+        used = offset + bytes;
+        allocated += bytes;
+        return blocks.back().get() + offset;
+    }
+
+    // Make the next `bytes` contiguous, e.g. before allocating a whole mesh
+    void reserve(size_t bytes) {
+        if (blocks.empty() || used + bytes > capacity) grow(bytes + alignof(std::max_align_t));
+    }
+
+    // Destroys everything, the arena can be reused afterwards
+    void release() {
+        for (size_t i = destructors.size(); i-- > 0;) {
+            destructors[i].destroy(destructors[i].object);
+        }
+        destructors.clear();
+        blocks.clear();
+        used = capacity = 0;
+        allocated = reserved = 0;
+    }
+
+    size_t bytesAllocated() const { return allocated; }
+    size_t bytesReserved() const { return reserved; }
+    size_t blockCount() const { return blocks.size(); }
+
+private:
+    struct Destructor {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<Destructor> destructors;
+    size_t blockBytes;
+    size_t used = 0;            // in the newest block
+    size_t capacity = 0;
+    size_t allocated = 0;       // bytes handed out
+    size_t reserved = 0;        // bytes in all blocks
+
+    // First offset in the newest block at or after `used` with the given address alignment
+    size_t alignedOffset(size_t align) const {
+        uintptr_t base = reinterpret_cast<uintptr_t>(blocks.back().get());
+        return ((base + used + align - 1) & ~(uintptr_t)(align - 1)) - base;
+    }
+
+    // The rest of the current block is abandoned
+    void grow(size_t atLeast) {
+        capacity = std::max(blockBytes, atLeast);
+        blocks.emplace_back(new char[capacity]);
+        reserved += capacity;
+        used = 0;
+    }
+};
+
+// Arenas of one tree, one per building thread
+class NodePool {
+public:
+    // A fresh arena for the calling thread, safe to call concurrently
+    Arena& acquire() {
+        std::lock_guard<std::mutex> guard(lock);
+        arenas.emplace_back(new Arena());
+        return *arenas.back();
+    }
+
+    // Takes the arenas of another pool, which is left empty
+    void adopt(NodePool& other) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& a : other.arenas) arenas.push_back(std::move(a));
+        other.arenas.clear();
+    }
+
+    size_t bytesReserved() const {
+        size_t bytes = 0;
+        for (const auto& a : arenas) bytes += a->bytesReserved();
+        return bytes;
+    }
+
+private:
+    std::mutex lock;
+    std::vector<std::unique_ptr<Arena>> arenas;
+};
+
+#endif
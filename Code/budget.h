@@ -0,0 +1,57 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// Resident-size queries and the --mem-budget check, with no scene
+// dependencies so loaders can call check() cheaply. The per-subsystem
+// breakdown (--mem-report) is in memory.h.
+
+namespace Memory {
+
+// Resident set size now, from /proc; 0 where that is not available
+inline size_t currentRSS() {
+    long pages = 0, resident = 0;
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (f == nullptr) return 0;
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(f);
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+inline size_t peakRSS() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (size_t)usage.ru_maxrss * 1024;     // kilobytes on Linux
+}
+
+// 0 = no budget
+inline size_t& budget() {
+    static size_t bytes = 0;
+    return bytes;
+}
+
+inline double mb(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// Exits if the process is over budget, or would be after `upcoming` more bytes
+inline void check(const char* stage, size_t upcoming = 0) {
+    if (budget() == 0) return;
+    size_t used = currentRSS();
+    if (used + upcoming <= budget()) return;
+
+    std::cerr << "\nMemory budget exceeded " << (upcoming ? "before " : "during ") << stage << ": "
+              << mb(used) << " MB resident";
+    if (upcoming) std::cerr << " + " << mb(upcoming) << " MB needed";
+    std::cerr << ", budget " << mb(budget()) << " MB\n";
+    std::exit(2);
+}
+
+} // namespace Memory
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef BVH_BUILDER_H
+#define BVH_BUILDER_H
+
+#include "BVH.h"
+#include "trace.h"
+#include <vector>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+// Binned SAH builder (Wald, "On fast Construction of SAH-based Bounding
+// Volume Hierarchies"). Subtrees above PARALLEL_THRESHOLD primitives are
+// handed to other threads while this thread builds the sibling.
+class BVHBuilder {
+public:
+    explicit BVHBuilder(int threadCount)
+        : threads(std::max(1, threadCount)), freeThreads(threads - 1) {}
+
+    // Hand ranges at depth deferDepth to defer() instead of building them
+    // The returned shape becomes the primitive of a leaf, see lazy_bvh.h
+    using DeferFn = std::function<Shape*(std::vector<Shape*>&&, const AABB&)>;
+    void setDefer(int depth, DeferFn fn) {
+        deferDepth = depth;
+        defer = std::move(fn);
+    }
+
+    BVHNode* build(const std::vector<Shape*>& shapes) {
+        if (shapes.empty()) return nullptr;
+        TRACE_SCOPE("BVH build", (int)shapes.size());
+
+        // Primitive bounds and centroids, computed in parallel
+        refs.resize(shapes.size());
+        parallelFor(shapes.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                refs[i].shape = shapes[i];
+                refs[i].box = shapes[i]->bounds();
+                refs[i].centre = refs[i].box.centre();
+            }
+        });
+
+        // Nodes go to per-thread arenas, the returned root owns them all
+        pool = new NodePool();
+        BVHNode* top = buildRange(0, refs.size(), pool->acquire());
+        BVHNode* root = BVHNode::makeRoot(top, pool);
+        pool = nullptr;
+        refs.clear();
+        refs.shrink_to_fit();
+        return root;
+    }
+
+    // Refit after shapes moved, then rebuild the highest subtrees whose
+    // SAH cost grew past threshold * build cost. Returns primitives rebuilt.
+    size_t update(BVHNode* root, float threshold = 1.3f) {
+        if (root == nullptr) return 0;
+        if (root->pool == nullptr) root->pool = new NodePool();
+        root->refit();
+        return rebuildDegraded(root, *root->pool, threshold);
+    }
+
+private:
+    struct PrimRef {
+        AABB box;
+        Vector3 centre;
+        Shape* shape;
+    };
+
+    struct Bin {
+        AABB box;
+        size_t count = 0;
+    };
+
+    static const int BINS = 16;
+    static const size_t PARALLEL_THRESHOLD = 4096;
+
+    std::vector<PrimRef> refs;
+    int threads;
+    std::atomic<int> freeThreads;
+    int deferDepth = -1;
+    DeferFn defer;
+    NodePool* pool = nullptr;   // of the tree being built
+
+    // Split [0, n) into one chunk per thread
+    template <typename F>
+    void parallelFor(size_t n, F f) const {
+        size_t chunks = std::min<size_t>(threads, (n + PARALLEL_THRESHOLD - 1) / PARALLEL_THRESHOLD);
+        if (chunks <= 1) {
+            f(0, n);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        size_t step = (n + chunks - 1) / chunks;
+        for (size_t c = 1; c < chunks; ++c) {
+            size_t begin = c * step;
+            size_t end = std::min(n, begin + step);
+            if (begin < end) workers.emplace_back([&f, begin, end] {
+                TRACE_SCOPE("BVH chunk");
+                f(begin, end);
+            });
+        }
+        f(0, std::min(n, step));
+        for (auto& w : workers) w.join();
+    }
+
+    void rangeBounds(size_t start, size_t end, AABB& box, AABB& cbox) const {
+        for (size_t i = start; i < end; ++i) {
+            box.expand(refs[i].box);
+            cbox.expand(refs[i].centre);
+        }
+    }
+
+    BVHNode* buildRange(size_t start, size_t end, Arena& arena, int depth = 0) {
+        bool root = (depth == 0);
+        size_t count = end - start;
+
+        // Base case
+        if (count == 1) {
+            return arena.makeTrivial<BVHNode>(refs[start].shape, nullptr, refs[start].box);
+        }
+
+        // Node and centroid bounds, per chunk in parallel at the root
+        AABB box, cbox;
+        if (root) {
+            std::vector<AABB> boxes(threads), cboxes(threads);
+            std::atomic<int> slot(0);
+            parallelFor(count, [&](size_t begin, size_t finish) {
+                int s = slot++;
+                rangeBounds(start + begin, start + finish, boxes[s], cboxes[s]);
+            });
+            for (int s = 0; s < threads; ++s) {
+                box.expand(boxes[s]);
+                cbox.expand(cboxes[s]);
+            }
+        } else {
+            rangeBounds(start, end, box, cbox);
+        }
+
+        if (depth == deferDepth && defer) {
+            std::vector<Shape*> shapes(count);
+            for (size_t i = 0; i < count; ++i) shapes[i] = refs[start + i].shape;
+            return arena.makeTrivial<BVHNode>(defer(std::move(shapes), box), nullptr, box);
+        }
+
+        size_t mid = findSplit(start, end, cbox);
+
+        // Farm out the left subtree if a thread is free
+        Shape* left;
+        Shape* right;
+        if (count > PARALLEL_THRESHOLD && freeThreads.fetch_sub(1) > 0) {
+            auto task = std::async(std::launch::async, [this, start, mid, depth] {
+                TRACE_SCOPE("BVH subtree", (int)(mid - start));
+                return buildRange(start, mid, pool->acquire(), depth + 1);
+            });
+            right = buildRange(mid, end, arena, depth + 1);
+            left = task.get();
+            freeThreads.fetch_add(1);
+        } else {
+            if (count > PARALLEL_THRESHOLD) freeThreads.fetch_add(1);
+            left = buildRange(start, mid, arena, depth + 1);
+            right = buildRange(mid, end, arena, depth + 1);
+        }
+
+        return arena.makeTrivial<BVHNode>(left, right, box);
+    }
+
+    // Partition refs around the cheapest binned SAH plane, returns the split index
+    size_t findSplit(size_t start, size_t end, const AABB& cbox) {
+        size_t count = end - start;
+        size_t mid = start + count / 2;
+
+        const float lo[3] = { cbox.min.x, cbox.min.y, cbox.min.z };
+        const float hi[3] = { cbox.max.x, cbox.max.y, cbox.max.z };
+
+        float bestCost = INFINITY;
+        int bestAxis = -1;
+        int bestBin = 0;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = hi[axis] - lo[axis];
+            if (extent <= 0.0f) continue;
+
+            Bin bins[BINS];
+            float scale = BINS / extent;
+            for (size_t i = start; i < end; ++i) {
+                Bin& b = bins[binIndex(refs[i].centre, axis, lo[axis], scale)];
+                b.box.expand(refs[i].box);
+                b.count++;
+            }
+
+            // Sweep from the right, then from the left
+            float rightArea[BINS];
+            size_t rightCount[BINS];
+            AABB acc;
+            size_t n = 0;
+            for (int b = BINS - 1; b > 0; --b) {
+                acc.expand(bins[b].box);
+                n += bins[b].count;
+                rightArea[b] = acc.surfaceArea();
+                rightCount[b] = n;
+            }
+
+            acc = AABB();
+            n = 0;
+            for (int b = 0; b < BINS - 1; ++b) {
+                acc.expand(bins[b].box);
+                n += bins[b].count;
+                if (n == 0 || rightCount[b + 1] == 0) continue;
+
+                float cost = n * acc.surfaceArea() + rightCount[b + 1] * rightArea[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        // All centroids in one place: plain median split
+        if (bestAxis < 0) return mid;
+
+        float scale = BINS / (hi[bestAxis] - lo[bestAxis]);
+        auto it = std::partition(refs.begin() + start, refs.begin() + end,
+            [&](const PrimRef& r) { return binIndex(r.centre, bestAxis, lo[bestAxis], scale) <= bestBin; });
+
+        size_t split = it - refs.begin();
+        if (split == start || split == end) return mid;
+        return split;
+    }
+
+    size_t rebuildDegraded(BVHNode* node, NodePool& owner, float threshold) {
+        if (node->right == nullptr) return 0;
+
+        if (node->cost > node->buildCost * threshold) {
+            return rebuild(node, owner);
+        }
+
+        size_t rebuilt = rebuildDegraded(static_cast<BVHNode*>(node->left), owner, threshold)
+                       + rebuildDegraded(static_cast<BVHNode*>(node->right), owner, threshold);
+        if (rebuilt > 0) node->computeCost();
+        return rebuilt;
+    }
+
+    // Replace the children of node with a fresh tree over the same shapes
+    // The old nodes stay in the owner's pool until the whole tree is deleted
+    size_t rebuild(BVHNode* node, NodePool& owner) {
+        std::vector<Shape*> shapes;
+        collectShapes(node, shapes);
+
+        BVHNode* fresh = build(shapes);
+        owner.adopt(*fresh->pool);
+
+        node->left = fresh->left;
+        node->right = fresh->right;
+        node->box = fresh->box;
+        node->box1 = fresh->box1;
+        node->moving = fresh->moving;
+        node->cost = fresh->cost;
+        node->buildCost = fresh->buildCost;
+        delete fresh;
+
+        return shapes.size();
+    }
+
+    static void collectShapes(const BVHNode* node, std::vector<Shape*>& out) {
+        if (node->right == nullptr) {
+            out.push_back(node->left);
+            return;
+        }
+        collectShapes(static_cast<const BVHNode*>(node->left), out);
+        collectShapes(static_cast<const BVHNode*>(node->right), out);
+    }
+
+    static int binIndex(const Vector3& c, int axis, float lo, float scale) {
+        float v = (axis == 0) ? c.x : (axis == 1) ? c.y : c.z;
+        return std::min(BINS - 1, static_cast<int>((v - lo) * scale));
+    }
+};
+
+#endif
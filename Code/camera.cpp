@@ -125,6 +125,16 @@ void Camera::calculateBasis() {
 
 // Convert pixel coordinates to ray
 // (px, py) range from (0, 0) to (resolutionX-1, resolutionY-1).
+Ray Camera::pixelToRay(float px, float py, int sX, int sY, int gridSide) const {
+    if (hasLens()) {
+        return hasMotion() ? pixelToRay<true, true>(px, py, sX, sY, gridSide)
+                           : pixelToRay<true, false>(px, py, sX, sY, gridSide);
+    }
+    return hasMotion() ? pixelToRay<false, true>(px, py, sX, sY, gridSide)
+                       : pixelToRay<false, false>(px, py, sX, sY, gridSide);
+}
+
+template <bool Lens, bool Motion>
 Ray Camera::pixelToRay(float px, float py, int sX, int sY, int gridSide) const {
 
     float u_normalized = (px + 0.5f) / resolutionX;
@@ -143,10 +153,11 @@ Ray Camera::pixelToRay(float px, float py, int sX, int sY, int gridSide) const {
 
 
     Vector3 currentPos = location;
+    float time = 0.0f;
 
     // Motion Blur
-    if (std::abs(velocity.x) > 1e-6 || std::abs(velocity.y) > 1e-6 || std::abs(velocity.z) > 1e-6) {
-        float time = randomFloat(); // random time between 0.0 and 1.0
+    if constexpr (Motion) {
+        time = randomFloat(); // random time between 0.0 and 1.0
         currentPos = location + (velocity * time);
     }
 
@@ -159,7 +170,7 @@ Ray Camera::pixelToRay(float px, float py, int sX, int sY, int gridSide) const {
 
     // Depth of Field
     // If aperture > 0, sample points on lens instead of pinhole
-    if (aperture > 0.0f) {
+    if constexpr (Lens) {
         
         float t = focalDistance / forward.dot(direction);
         Vector3 focalPoint = currentPos + (direction * t);
@@ -175,11 +186,16 @@ Ray Camera::pixelToRay(float px, float py, int sX, int sY, int gridSide) const {
         Vector3 lensDir = focalPoint - lensOrigin;
         lensDir.normalize();
 
-        return Ray(lensOrigin, lensDir);
+        return Ray(lensOrigin, lensDir, time);
     }
 
     // Default pinhole camera
-    return Ray(currentPos, direction);
+    return Ray(currentPos, direction, time);
 
 
 }
+
+template Ray Camera::pixelToRay<false, false>(float, float, int, int, int) const;
+template Ray Camera::pixelToRay<false, true>(float, float, int, int, int) const;
+template Ray Camera::pixelToRay<true, false>(float, float, int, int, int) const;
+template Ray Camera::pixelToRay<true, true>(float, float, int, int, int) const;
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <fstream>
+#include <cmath>
 
 #include "maths.h"
 
@@ -31,6 +32,15 @@ public:
 
     Ray pixelToRay(float px, float py, int sX, int sY, int gridSide) const;
 
+    // Specialised ray generation, chosen once per render
+    template <bool Lens, bool Motion>
+    Ray pixelToRay(float px, float py, int sX, int sY, int gridSide) const;
+
+    bool hasLens() const { return aperture > 0.0f; }
+    bool hasMotion() const {
+        return std::abs(velocity.x) > 1e-6 || std::abs(velocity.y) > 1e-6 || std::abs(velocity.z) > 1e-6;
+    }
+
 private:
 
     Vector3 right;
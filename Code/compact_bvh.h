@@ -0,0 +1,207 @@
+#ifndef COMPACT_BVH_H
+#define COMPACT_BVH_H
+
+#include "BVH.h"
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// 4-wide BVH packed into 64-byte nodes, one cache line each
+// Child boxes are 8-bit offsets on a grid over the parent box, rounded
+// outwards so the decoded box always contains the child. Collapsed from a
+// binary BVHNode tree, which can be deleted afterwards (shapes are shared).
+class CompactBVH : public Shape {
+public:
+    struct alignas(64) Node {
+        float origin[3];        // parent box min
+        float step[3];          // parent extent / 255 per axis
+        uint8_t lo[3][4];       // child min per axis, in steps from origin
+        uint8_t hi[3][4];       // child max per axis
+        uint32_t child[4];      // node index, primitive index | LEAF, or EMPTY
+    };
+    static_assert(sizeof(Node) == 64, "CompactBVH::Node must fill one cache line");
+
+    static const uint32_t LEAF = 0x80000000u;
+    static const uint32_t EMPTY = 0xffffffffu;
+
+    std::vector<Node> nodes;            // nodes[0] is the root
+    std::vector<const Shape*> prims;
+    AABB box;
+    bool valid = true;                  // false if the tree is too deep to traverse
+
+    explicit CompactBVH(const BVHNode* root) {
+        if (root == nullptr) return;
+        box = root->bounds();
+        int depth = 0;
+        flatten(root, 1, depth);
+        valid = 3 * depth + 1 <= STACK_SIZE;
+    }
+
+    size_t memoryBytes() const {
+        return nodes.size() * sizeof(Node) + prims.size() * sizeof(const Shape*);
+    }
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        if (nodes.empty()) return false;
+
+        const float o[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+        const float d[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+        float invD[3];
+        bool parallel[3];
+        for (int a = 0; a < 3; ++a) {
+            parallel[a] = std::abs(d[a]) < 1e-8f;
+            invD[a] = 1.0f / d[a];
+        }
+
+        uint32_t stack[STACK_SIZE];
+        int sp = 0;
+        stack[sp++] = 0;
+
+        bool found = false;
+        while (sp > 0) {
+            const Node& node = nodes[stack[--sp]];
+            RT_STAT(STAT_BVH_NODES);
+
+            for (int i = 0; i < 4; ++i) {
+                uint32_t c = node.child[i];
+                if (c == EMPTY) break;
+
+                // Decode the child box and run the slab test
+                float tmin = 0.0f;
+                float tmax = hit.t;
+                for (int a = 0; a < 3; ++a) {
+                    float mi = node.origin[a] + node.lo[a][i] * node.step[a];
+                    float ma = node.origin[a] + node.hi[a][i] * node.step[a];
+
+                    if (parallel[a]) {
+                        if (o[a] < mi || o[a] > ma) tmax = -1.0f;
+                        continue;
+                    }
+
+                    float t0 = (mi - o[a]) * invD[a];
+                    float t1 = (ma - o[a]) * invD[a];
+                    if (invD[a] < 0.0f) std::swap(t0, t1);
+                    tmin = std::max(tmin, t0);
+                    tmax = std::min(tmax, t1);
+                }
+                if (tmax < tmin) continue;
+
+                if (c & LEAF) {
+                    found |= prims[c & ~LEAF]->intersect(ray, hit);
+                } else {
+                    stack[sp++] = c;
+                }
+            }
+        }
+        return found;
+    }
+
+    AABB bounds() const override {
+        return box;
+    }
+
+    Vector3 centroid() const override {
+        return box.centre();
+    }
+
+private:
+    // Each node pushes at most 3 children beyond the one it replaces
+    static const int STACK_SIZE = 256;
+
+    uint32_t flatten(const BVHNode* node, int level, int& depth) {
+        depth = std::max(depth, level);
+
+        uint32_t index = (uint32_t)nodes.size();
+        nodes.emplace_back();
+
+        // Open the largest internal child until there are 4
+        const BVHNode* kids[4];
+        int n = 0;
+        if (node->right == nullptr) {
+            kids[n++] = node;
+        } else {
+            kids[n++] = static_cast<const BVHNode*>(node->left);
+            kids[n++] = static_cast<const BVHNode*>(node->right);
+        }
+
+        while (n < 4) {
+            int best = -1;
+            float bestArea = -1.0f;
+            for (int i = 0; i < n; ++i) {
+                if (kids[i]->right == nullptr) continue;
+                float area = kids[i]->bounds().surfaceArea();
+                if (area > bestArea) {
+                    bestArea = area;
+                    best = i;
+                }
+            }
+            if (best < 0) break;
+
+            const BVHNode* open = kids[best];
+            kids[best] = static_cast<const BVHNode*>(open->left);
+            kids[n++] = static_cast<const BVHNode*>(open->right);
+        }
+
+        // Quantisation grid over this node's box
+        // Filled locally, recursion below may reallocate nodes
+        Node out;
+        AABB parent = node->bounds();
+        const float pmin[3] = { parent.min.x, parent.min.y, parent.min.z };
+        const float pmax[3] = { parent.max.x, parent.max.y, parent.max.z };
+        for (int a = 0; a < 3; ++a) {
+            out.origin[a] = pmin[a];
+            float step = (pmax[a] - pmin[a]) / 255.0f;
+            while (step > 0.0f && out.origin[a] + 255.0f * step < pmax[a]) {
+                step = std::nextafter(step, INFINITY);
+            }
+            out.step[a] = step;
+        }
+
+        for (int i = 0; i < 4; ++i) {
+            if (i >= n) {
+                // Empty slot: min above max never hits
+                for (int a = 0; a < 3; ++a) {
+                    out.lo[a][i] = 255;
+                    out.hi[a][i] = 0;
+                }
+                out.child[i] = EMPTY;
+                continue;
+            }
+
+            AABB b = kids[i]->bounds();
+            const float cmin[3] = { b.min.x, b.min.y, b.min.z };
+            const float cmax[3] = { b.max.x, b.max.y, b.max.z };
+            for (int a = 0; a < 3; ++a) {
+                out.lo[a][i] = quantize(cmin[a], out.origin[a], out.step[a], false);
+                out.hi[a][i] = quantize(cmax[a], out.origin[a], out.step[a], true);
+            }
+
+            if (kids[i]->right == nullptr) {
+                out.child[i] = (uint32_t)prims.size() | LEAF;
+                prims.push_back(kids[i]->left);
+            } else {
+                out.child[i] = flatten(kids[i], level + 1, depth);
+            }
+        }
+
+        nodes[index] = out;
+        return index;
+    }
+
+    // Round down for a min, up for a max, then fix any float error
+    static uint8_t quantize(float v, float origin, float step, bool up) {
+        if (step <= 0.0f) return 0;
+
+        float q = (v - origin) / step;
+        int i = std::clamp(static_cast<int>(up ? std::ceil(q) : std::floor(q)), 0, 255);
+        if (up) {
+            while (i < 255 && origin + i * step < v) i++;
+        } else {
+            while (i > 0 && origin + i * step > v) i--;
+        }
+        return static_cast<uint8_t>(i);
+    }
+};
+
+#endif
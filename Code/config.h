@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include <string>
+#include <cstdint>
 
 
 // Tone Mapping 
@@ -12,13 +13,48 @@ enum class ToneMappingMode {
 };
 
 
+// Per-pixel cost image
+enum class HeatmapMode {
+    Off,
+    Time,       // cycle counter per pixel
+    Rays        // rays traced per pixel, shadow rays included
+};
+
+
+// Acceleration structure
+enum class AccelType {
+    BVH,
+    Grid
+};
+
+
+// BVH construction
+enum class BVHBuildMode {
+    Median,     // recursive median split
+    Binned,     // parallel binned SAH
+    Spatial     // SAH with spatial splits (SBVH), duplicates clipped triangles
+};
+
+
+// BVH node storage
+enum class BVHLayout {
+    Full,       // binary BVHNode tree, float boxes
+    Compact     // 4-wide 64-byte nodes with 8-bit quantised boxes
+};
+
+
 struct RenderConfig {
     // Default settings
     int width = 0;              // use camera default
     int height = 0;
     int maxDepth = 3;
     int samplesPerPixel = 1;    // 1 = no AA
-    bool useBVH = true;
+    bool useBVH = true;         // false = test every shape
+    AccelType accel = AccelType::BVH;
+    BVHBuildMode bvhBuild = BVHBuildMode::Binned;
+    BVHLayout bvhLayout = BVHLayout::Full;
+    bool lazyBVH = false;       // build lower levels on first use
+    int buildThreads = 0;       // 0 = all cores
     bool useShadows = true;    
 
     int shadowSamples = 1;      
@@ -28,6 +64,32 @@ struct RenderConfig {
     ToneMappingMode toneMapping = ToneMappingMode::ACES;
 
     bool noShading = false; 
+    uint64_t seed = 1337;       // every camera sample is seeded from this and its pixel
+
+    std::string statsFile;      // JSON counters, needs a STATS=1 build
+    HeatmapMode heatmap = HeatmapMode::Off;
+    std::string traceFile;      // Chrome trace-event JSON of load, build and render
+    std::string captureFile;    // every traced ray, for Bench/replay
+    bool memReport = false;     // footprint after load, after build and at exit
+    size_t memBudgetMB = 0;     // 0 = unlimited
+
+    std::string serveSocket;    // --serve: render jobs from a Unix socket
+    int renderThreads = 0;      // server pool, 0 = all cores
+    int cacheScenes = 4;        // scenes the server keeps loaded
+
+    int coordinatorPort = -1;   // --coordinator: farm tiles out to workers, 0 = any free port
+    int spawnWorkers = 0;       // local worker processes started by the coordinator
+    std::string workerOf;       // --worker host:port
+    int tileSize = 32;
+
+    bool preview = false;       // coarse-to-fine, rewrites the output after each level
+
+    bool crop = false;          // -crop: trace only this window of the frame
+    float cropWindow[4] = { 0, 0, 0, 0 };  // x0 y0 x1 y1, pixels or fractions of the frame
+    bool cropNormalized = false;
+    std::string cropInto;       // composite the crop into this frame-sized PPM instead of writing it alone
+
+    std::string gbufferFile;    // --gbuffer: primary hits kept between runs, re-shades only what changed
     
     std::string inputScene = "Test1.txt";
     std::string outputImage = "output.ppm";
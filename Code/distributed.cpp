@@ -0,0 +1,501 @@
+#include "distributed.h"
+#include "raytracer.h"
+#include "scene.h"
+#include "image.h"
+#include "accel.h"
+#include "json.h"
+
+#include <algorithm>
+#include <csignal>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Protocol: JSON lines over TCP, one connection per worker thread.
+//
+//   coordinator -> worker  {"scene": "../ASCII/Test1.txt", "width": 1920, ..., "seed": "1337"}
+//   worker -> coordinator  {"status": "ready"}  or  {"status": "error", "message": ...}
+//   coordinator -> worker  {"tile": 7, "rect": [x0, y0, x1, y1]}
+//   worker -> coordinator  {"tile": 7, "floats": n} then n raw floats (RGB radiance, row-major)
+//   coordinator -> worker  {"command": "done"}
+//
+// Each worker holds one tile at a time, so fast workers simply take more.
+// When a connection drops its tile goes back to the queue. Radiance floats
+// travel in host byte order, all supported hosts are little-endian.
+
+using Clock = std::chrono::steady_clock;
+
+static const int MAX_ATTEMPTS = 3;     // per tile, then the frame fails
+
+static bool sendAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool sendLine(int fd, const std::string& line) {
+    std::string data = line + "\n";
+    return sendAll(fd, data.data(), data.size());
+}
+
+// Buffered reads of lines and fixed-size payloads from a socket
+class Reader {
+public:
+    explicit Reader(int fd) : fd(fd) {}
+
+    bool line(std::string& out) {
+        size_t newline;
+        while ((newline = buffer.find('\n')) == std::string::npos) {
+            if (!fill()) return false;
+        }
+        out = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        return true;
+    }
+
+    bool exact(void* data, size_t size) {
+        char* p = static_cast<char*>(data);
+        while (size > 0) {
+            if (buffer.empty() && !fill()) return false;
+            size_t n = std::min(size, buffer.size());
+            std::memcpy(p, buffer.data(), n);
+            buffer.erase(0, n);
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool json(Json::Value& out) {
+        std::string text;
+        if (!line(text)) return false;
+        Json::Parser parser(text);
+        return parser.parse(out) && out.type == Json::Value::Object;
+    }
+
+private:
+    int fd;
+    std::string buffer;
+
+    bool fill() {
+        char chunk[65536];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+        return true;
+    }
+};
+
+// Everything a worker needs to reproduce the coordinator's samples
+static std::string jobLine(const RenderConfig& c, int width, int height) {
+    std::ostringstream out;
+    out << "{\"scene\": " << Json::quote(c.inputScene) << ", \"width\": " << width << ", \"height\": " << height
+        << ", \"spp\": " << c.samplesPerPixel << ", \"depth\": " << c.maxDepth
+        << ", \"shadowSamples\": " << c.shadowSamples << ", \"glossySamples\": " << c.glossySamples
+        << ", \"shadows\": " << (c.useShadows ? "true" : "false") << ", \"shading\": " << (c.noShading ? "false" : "true")
+        << ", \"useBVH\": " << (c.useBVH ? "true" : "false") << ", \"accel\": " << static_cast<int>(c.accel)
+        << ", \"bvhBuild\": " << static_cast<int>(c.bvhBuild) << ", \"bvhLayout\": " << static_cast<int>(c.bvhLayout)
+        << ", \"lazy\": " << (c.lazyBVH ? "true" : "false")
+        << ", \"seed\": \"" << c.seed << "\"}";      // as a string, doubles lose 64-bit seeds
+    return out.str();
+}
+
+static void applyJob(const Json::Value& job, RenderConfig& c) {
+    c.inputScene = job["scene"].str("");
+    c.width = (int)job["width"].num(0);
+    c.height = (int)job["height"].num(0);
+    c.samplesPerPixel = (int)job["spp"].num(c.samplesPerPixel);
+    c.maxDepth = (int)job["depth"].num(c.maxDepth);
+    c.shadowSamples = (int)job["shadowSamples"].num(c.shadowSamples);
+    c.glossySamples = (int)job["glossySamples"].num(c.glossySamples);
+    c.useShadows = job["shadows"].boolean;
+    c.noShading = !job["shading"].boolean;
+    c.useBVH = job["useBVH"].boolean;
+    c.accel = static_cast<AccelType>((int)job["accel"].num(0));
+    c.bvhBuild = static_cast<BVHBuildMode>((int)job["bvhBuild"].num(0));
+    c.bvhLayout = static_cast<BVHLayout>((int)job["bvhLayout"].num(0));
+    c.lazyBVH = job["lazy"].boolean;
+    c.seed = std::stoull(job["seed"].str("0"));
+    c.heatmap = HeatmapMode::Off;
+    c.captureFile.clear();
+}
+
+// ---------------------------------------------------------------- coordinator
+
+struct Farm {
+    std::vector<Tile> tiles;
+    std::vector<int> attempts;
+    std::vector<Vector3> radiance;      // frame-sized
+    int width = 0;
+    std::string job;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<int> pending;
+    int done = 0;
+    bool failed = false;
+    int connected = 0;
+
+    bool finished() const {
+        return failed || done == (int)tiles.size();
+    }
+};
+
+// Hands out tiles until the frame is done or the worker goes away
+static void coordinate(Farm& farm, int fd, std::string name) {
+    Reader in(fd);
+    Json::Value reply;
+    if (!sendLine(fd, farm.job) || !in.json(reply) || reply["status"].str("") != "ready") {
+        std::cerr << "Worker " << name << " not ready: " << reply["message"].str("connection lost") << "\n";
+        close(fd);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(farm.lock);
+        farm.connected++;
+    }
+
+    int rendered = 0;
+    for (;;) {
+        int t;
+        {
+            std::unique_lock<std::mutex> guard(farm.lock);
+            farm.changed.wait(guard, [&] { return farm.finished() || !farm.pending.empty(); });
+            if (farm.finished()) break;
+            t = farm.pending.front();
+            farm.pending.pop_front();
+        }
+
+        const Tile& tile = farm.tiles[t];
+        int w = tile.x1 - tile.x0, h = tile.y1 - tile.y0;
+        std::vector<Vector3> pixels((size_t)w * h);
+        std::ostringstream request;
+        request << "{\"tile\": " << t << ", \"rect\": [" << tile.x0 << ", " << tile.y0 << ", " << tile.x1 << ", " << tile.y1 << "]}";
+
+        bool ok = sendLine(fd, request.str()) && in.json(reply)
+               && (int)reply["tile"].num(-1) == t && (size_t)reply["floats"].num(0) == pixels.size() * 3
+               && in.exact(pixels.data(), pixels.size() * sizeof(Vector3));
+
+        std::lock_guard<std::mutex> guard(farm.lock);
+        if (!ok) {
+            // Someone else retries the tile
+            std::cerr << "Worker " << name << " lost with tile " << t << ", requeued\n";
+            if (++farm.attempts[t] >= MAX_ATTEMPTS) {
+                std::cerr << "Tile " << t << " failed " << MAX_ATTEMPTS << " times, giving up\n";
+                farm.failed = true;
+            }
+            farm.pending.push_front(t);
+            farm.connected--;
+            farm.changed.notify_all();
+            close(fd);
+            return;
+        }
+        for (int y = 0; y < h; ++y) {
+            std::copy(pixels.begin() + (size_t)y * w, pixels.begin() + (size_t)(y + 1) * w,
+                      farm.radiance.begin() + (size_t)(tile.y0 + y) * farm.width + tile.x0);
+        }
+        farm.done++;
+        rendered++;
+        farm.changed.notify_all();
+    }
+
+    sendLine(fd, "{\"command\": \"done\"}");
+    close(fd);
+    std::lock_guard<std::mutex> guard(farm.lock);
+    farm.connected--;
+    std::cout << "Worker " << name << ": " << rendered << " tiles\n";
+}
+
+// Local worker process talking to 127.0.0.1:port, stdout silenced
+static pid_t spawnWorker(int port) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0) dup2(null, STDOUT_FILENO);
+    std::string address = "127.0.0.1:" + std::to_string(port);
+    execl("/proc/self/exe", "raytracer", "--worker", address.c_str(), "-threads", "1", (char*)nullptr);
+    std::cerr << "Cannot start worker: " << std::strerror(errno) << "\n";
+    _exit(127);
+}
+
+int runCoordinator(const RenderConfig& config) {
+    Camera cam;
+    Scene scene;
+    if (!loadScene(config.inputScene, cam, scene)) {
+        std::cerr << "Error: Scene failed to load: " << config.inputScene << "\n";
+        return 1;
+    }
+    if (config.width > 0) cam.resolutionX = config.width;
+    if (config.height > 0) cam.resolutionY = config.height;
+
+    Farm farm;
+    farm.width = cam.resolutionX;
+    farm.job = jobLine(config, cam.resolutionX, cam.resolutionY);
+    farm.radiance.assign((size_t)cam.resolutionX * cam.resolutionY, Vector3(0, 0, 0));
+    int size = std::max(1, config.tileSize);
+    for (int y = 0; y < cam.resolutionY; y += size) {
+        for (int x = 0; x < cam.resolutionX; x += size) {
+            farm.pending.push_back((int)farm.tiles.size());
+            farm.tiles.push_back(Tile{ x, y, std::min(x + size, cam.resolutionX), std::min(y + size, cam.resolutionY) });
+        }
+    }
+    farm.attempts.assign(farm.tiles.size(), 0);
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(config.coordinatorPort));
+    socklen_t addrSize = sizeof(addr);
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 64) != 0
+        || getsockname(listenFd, (sockaddr*)&addr, &addrSize) != 0) {
+        std::cerr << "Cannot listen on port " << config.coordinatorPort << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    int port = ntohs(addr.sin_port);
+    std::cout << "Coordinator on port " << port << ": " << farm.tiles.size() << " tiles of " << size << "x" << size
+              << " at " << cam.resolutionX << "x" << cam.resolutionY << "\n";
+
+    std::vector<pid_t> children;    // still running
+    for (int i = 0; i < config.spawnWorkers; ++i) {
+        pid_t pid = spawnWorker(port);
+        if (pid > 0) children.push_back(pid);
+    }
+
+    auto start = Clock::now();
+    std::vector<std::thread> sessions;
+    int lastDone = -1;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> guard(farm.lock);
+            if (farm.finished()) break;
+            if (farm.done != lastDone) {
+                lastDone = farm.done;
+                std::cout << "Tiles: " << farm.done << "/" << farm.tiles.size() << " (" << farm.connected << " workers)\r" << std::flush;
+            }
+        }
+
+        // Without remote workers a frame whose local workers all died would wait forever
+        for (size_t i = 0; i < children.size();) {
+            if (waitpid(children[i], nullptr, WNOHANG) == children[i]) {
+                children.erase(children.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+        if (config.spawnWorkers > 0 && children.empty()) {
+            std::lock_guard<std::mutex> guard(farm.lock);
+            if (farm.connected == 0) {
+                std::cerr << "\nError: every local worker exited\n";
+                farm.failed = true;
+                farm.changed.notify_all();
+                break;
+            }
+        }
+
+        pollfd p{ listenFd, POLLIN, 0 };
+        if (poll(&p, 1, 200) <= 0) continue;
+
+        sockaddr_storage peer{};
+        socklen_t peerSize = sizeof(peer);
+        int fd = accept(listenFd, (sockaddr*)&peer, &peerSize);
+        if (fd < 0) continue;
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &yes, sizeof(yes));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        char host[NI_MAXHOST] = "?", service[NI_MAXSERV] = "?";
+        getnameinfo((sockaddr*)&peer, peerSize, host, sizeof(host), service, sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV);
+        sessions.emplace_back(coordinate, std::ref(farm), fd, std::string(host) + ":" + service);
+    }
+    close(listenFd);
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::cout << "\n";
+
+    // Connected workers got "done"; spawned ones that never got a tile are still retrying
+    for (auto& s : sessions) s.join();
+    for (pid_t pid : children) {
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+    }
+
+    if (farm.failed) {
+        std::cerr << "Error: distributed render failed\n";
+        return 1;
+    }
+    int retries = 0;
+    for (int a : farm.attempts) retries += a;
+    std::cout << "Render Complete\n";
+    std::cout << "Time Taken: " << elapsed.count() << " seconds (" << sessions.size() << " workers, "
+              << retries << " tiles retried)\n";
+
+    // Same conversion the render kernels apply, so the image matches a local render
+    Raytracer tracer(&cam, &scene, nullptr, config);
+    Image img(cam.resolutionX, cam.resolutionY);
+    for (int y = 0; y < img.getHeight(); ++y) {
+        for (int x = 0; x < img.getWidth(); ++x) {
+            img.setPixel(x, y, tracer.toPixel(farm.radiance[(size_t)y * farm.width + x]));
+        }
+    }
+    if (!img.writePPM(config.outputImage)) {
+        std::cerr << "Error: Failed to save image\n";
+        return 1;
+    }
+    std::cout << "Saved to " << config.outputImage << "\n";
+    return 0;
+}
+
+// ---------------------------------------------------------------- worker
+
+// Scene shared by the worker's connections, loaded by the first job
+struct WorkerScene {
+    std::once_flag once;
+    bool ok = false;
+    RenderConfig config;
+    Camera cam;
+    Scene scene;
+    Shape* accel = nullptr;
+
+    ~WorkerScene() {
+        delete accel;
+    }
+};
+
+static int connectTo(const std::string& host, const std::string& port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) return -1;
+
+    int fd = -1;
+    for (addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+// Renders tiles for one coordinator connection
+static bool work(WorkerScene& shared, const RenderConfig& defaults, const std::string& host, const std::string& port) {
+    // The coordinator may still be starting
+    int fd = -1;
+    for (int attempt = 0; attempt < 50 && fd < 0; ++attempt) {
+        fd = connectTo(host, port);
+        if (fd < 0) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    if (fd < 0) {
+        std::cerr << "Cannot reach coordinator " << host << ":" << port << "\n";
+        return false;
+    }
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+    Reader in(fd);
+    Json::Value job;
+    if (!in.json(job)) {
+        close(fd);
+        return false;
+    }
+    std::call_once(shared.once, [&] {
+        shared.config = defaults;
+        applyJob(job, shared.config);
+        if (!loadScene(shared.config.inputScene, shared.cam, shared.scene)) return;
+        shared.cam.resolutionX = shared.config.width;
+        shared.cam.resolutionY = shared.config.height;
+        shared.accel = buildAcceleration(shared.scene, shared.config);
+        shared.ok = true;
+    });
+    if (!shared.ok) {
+        sendLine(fd, "{\"status\": \"error\", \"message\": " + Json::quote("cannot load " + job["scene"].str("")) + "}");
+        close(fd);
+        return false;
+    }
+    sendLine(fd, "{\"status\": \"ready\"}");
+
+    // Frame-sized buffers, renderTile writes at frame coordinates
+    Raytracer tracer(&shared.cam, &shared.scene, shared.accel, shared.config);
+    Image img(shared.cam.resolutionX, shared.cam.resolutionY);
+    std::vector<Vector3> radiance((size_t)img.getWidth() * img.getHeight());
+
+    bool ok = false;
+    Json::Value request;
+    while (in.json(request)) {
+        if (request["command"].str("") == "done") {
+            ok = true;
+            break;
+        }
+        const Json::Value& rect = request["rect"];
+        if (rect.type != Json::Value::Array || rect.array.size() != 4) break;
+        Tile tile{ (int)rect.array[0].num(0), (int)rect.array[1].num(0), (int)rect.array[2].num(0), (int)rect.array[3].num(0) };
+        tile.x0 = std::clamp(tile.x0, 0, img.getWidth());
+        tile.x1 = std::clamp(tile.x1, tile.x0, img.getWidth());
+        tile.y0 = std::clamp(tile.y0, 0, img.getHeight());
+        tile.y1 = std::clamp(tile.y1, tile.y0, img.getHeight());
+
+        tracer.renderTile(img, tile, radiance.data());
+
+        std::vector<Vector3> pixels;
+        pixels.reserve((size_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+        for (int y = tile.y0; y < tile.y1; ++y) {
+            pixels.insert(pixels.end(), radiance.begin() + (size_t)y * img.getWidth() + tile.x0,
+                          radiance.begin() + (size_t)y * img.getWidth() + tile.x1);
+        }
+        std::ostringstream header;
+        header << "{\"tile\": " << (int)request["tile"].num(-1) << ", \"floats\": " << pixels.size() * 3 << "}";
+        if (!sendLine(fd, header.str()) || !sendAll(fd, pixels.data(), pixels.size() * sizeof(Vector3))) break;
+    }
+    close(fd);
+    return ok;
+}
+
+int runWorker(const RenderConfig& config) {
+    static_assert(sizeof(Vector3) == 3 * sizeof(float), "tiles are sent as packed RGB floats");
+
+    size_t colon = config.workerOf.rfind(':');
+    if (colon == std::string::npos) {
+        std::cerr << "Expected --worker host:port, got " << config.workerOf << "\n";
+        return 1;
+    }
+    std::string host = config.workerOf.substr(0, colon);
+    std::string port = config.workerOf.substr(colon + 1);
+
+    // One connection per thread, each asks for its own tiles
+    int threads = config.renderThreads > 0 ? config.renderThreads : std::max(1u, std::thread::hardware_concurrency());
+    WorkerScene shared;
+    std::vector<std::thread> pool;
+    std::vector<char> results(threads, 0);
+    for (int i = 0; i < threads; ++i) {
+        pool.emplace_back([&, i] { results[i] = work(shared, config, host, port); });
+    }
+    for (auto& t : pool) t.join();
+
+    bool ok = std::all_of(results.begin(), results.end(), [](char r) { return r != 0; });
+    return ok ? 0 : 1;
+}
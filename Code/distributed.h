@@ -0,0 +1,12 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "config.h"
+
+// Tile farm over TCP, see distributed.cpp. The coordinator loads the scene
+// for its camera, hands tiles to whichever worker is free and writes the
+// image; workers load the same scene file themselves. Both return the exit code.
+int runCoordinator(const RenderConfig& config);
+int runWorker(const RenderConfig& config);
+
+#endif
@@ -0,0 +1,248 @@
+#include "gbuffer.h"
+#include "raytracer.h"
+#include "image.h"
+#include "trace.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+
+// File layout, host byte order:
+//   "RTGB" version width height samples renderKey geometryKey
+//   objects lights materialKeys[objects] lightKeys[lights]
+//   radiance[w*h] touched[w*h] hits[w*h*samples]
+
+static const char MAGIC[4] = { 'R', 'T', 'G', 'B' };
+static const uint32_t VERSION = 1;
+
+// FNV-1a
+class Hash {
+public:
+    void bytes(const void* data, size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            value = (value ^ p[i]) * 1099511628211ull;
+        }
+    }
+    template <typename T> void add(const T& v) { bytes(&v, sizeof(v)); }
+    void add(const std::string& s) { bytes(s.data(), s.size() + 1); }
+    void add(const Vector3& v) { add(v.x); add(v.y); add(v.z); }
+
+    // Name and bytes, so an edit to the file changes the key
+    void addFile(const std::string& path) {
+        add(path);
+        std::ifstream file(path, std::ios::binary);
+        char buffer[1 << 16];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+            bytes(buffer, (size_t)file.gcount());
+        }
+    }
+
+    uint64_t value = 14695981039346656037ull;
+};
+
+// Decoded texels, hashed once per texture name (every material naming it loads the same file)
+static uint64_t textureKey(const Material& m, std::map<std::string, uint64_t>& seen) {
+    auto it = seen.find(m.textureName);
+    if (it != seen.end()) return it->second;
+
+    Hash h;
+    if (m.texture) {
+        const Image& t = *m.texture;
+        h.add(t.getWidth());
+        h.add(t.getHeight());
+        for (int y = 0; y < t.getHeight(); ++y) {
+            for (int x = 0; x < t.getWidth(); ++x) {
+                Pixel p = t.getPixel(x, y);
+                h.add(p.r); h.add(p.g); h.add(p.b);
+            }
+        }
+    }
+    return seen[m.textureName] = h.value;
+}
+
+static uint64_t materialKey(const Material& m, std::map<std::string, uint64_t>& textures) {
+    Hash h;
+    h.add(m.diffuse);
+    h.add(m.specular);
+    h.add(m.shininess);
+    h.add(m.reflectivity);
+    h.add(m.transparency);
+    h.add(m.ior);
+    h.add(m.roughness);
+    h.add(m.textureName);
+    if (!m.textureName.empty()) h.add(textureKey(m, textures));
+    return h.value;
+}
+
+static uint64_t lightKey(const Light& l) {
+    Hash h;
+    h.add(l.position);
+    h.add(l.intensity);
+    h.add(l.radius);
+    return h.value;
+}
+
+// Settings that change radiance; exposure and tone mapping only change its display
+static uint64_t renderKey(const RenderConfig& c, int width, int height, int samples) {
+    Hash h;
+    h.add(width);
+    h.add(height);
+    h.add(samples);
+    h.add(c.samplesPerPixel);   // spp 1 and 2 both take one sample, but only 2 jitters it
+    h.add(c.seed);
+    h.add(c.maxDepth);
+    h.add(c.shadowSamples);
+    h.add(c.glossySamples);
+    h.add(c.noShading);
+    return h.value;
+}
+
+// Every token of the scene file except material values and light blocks,
+// so camera, transform and vertex edits count as geometry, plus the
+// contents of each mesh file the scene loaded
+static uint64_t geometryKey(const std::string& sceneFile, const Scene& scene) {
+    static const std::set<std::string> material1 = { "shininess", "roughness", "reflectivity", "transparency", "ior", "texture" };
+    static const std::set<std::string> material3 = { "diffuse", "specular" };
+
+    Hash h;
+    std::ifstream file(sceneFile);
+    std::string token;
+    bool inLight = false;
+    while (file >> token) {
+        if (token == "BEGIN_LIGHT") inLight = true;
+        if (inLight) {
+            if (token == "END_LIGHT") inLight = false;
+            continue;
+        }
+        int skip = material1.count(token) ? 1 : material3.count(token) ? 3 : 0;
+        if (skip > 0) {
+            for (int i = 0; i < skip && file >> token; ++i) {}
+            continue;
+        }
+        h.add(token);
+    }
+    for (const auto& m : scene.meshes) h.addFile(m.first);
+    return h.value;
+}
+
+template <typename T>
+static void writeVector(std::ofstream& out, const std::vector<T>& v) {
+    out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+template <typename T>
+static bool readVector(std::ifstream& in, std::vector<T>& v, size_t count) {
+    v.resize(count);
+    return (bool)in.read(reinterpret_cast<char*>(v.data()), count * sizeof(T));
+}
+
+bool GBuffer::write(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) return false;
+
+    uint32_t header[6] = { VERSION, (uint32_t)width, (uint32_t)height, (uint32_t)samples,
+                           (uint32_t)materialKeys.size(), (uint32_t)lightKeys.size() };
+    out.write(MAGIC, sizeof(MAGIC));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&renderKey), sizeof(renderKey));
+    out.write(reinterpret_cast<const char*>(&geometryKey), sizeof(geometryKey));
+    writeVector(out, materialKeys);
+    writeVector(out, lightKeys);
+    writeVector(out, radiance);
+    writeVector(out, touched);
+    writeVector(out, hits);
+    return (bool)out;
+}
+
+bool GBuffer::read(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    char magic[4];
+    uint32_t header[6];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != VERSION) return false;
+
+    width = (int)header[1];
+    height = (int)header[2];
+    samples = (int)header[3];
+    size_t pixels = (size_t)width * height;
+    return in.read(reinterpret_cast<char*>(&renderKey), sizeof(renderKey))
+        && in.read(reinterpret_cast<char*>(&geometryKey), sizeof(geometryKey))
+        && readVector(in, materialKeys, header[4])
+        && readVector(in, lightKeys, header[5])
+        && readVector(in, radiance, pixels)
+        && readVector(in, touched, pixels)
+        && readVector(in, hits, pixels * samples);
+}
+
+void renderIncremental(const Raytracer& tracer, const Scene& scene, const Camera& cam,
+                       const RenderConfig& config, Image& img) {
+    int gridSide = std::max(1, static_cast<int>(std::sqrt(config.samplesPerPixel)));
+
+    GBuffer next;
+    next.width = cam.resolutionX;
+    next.height = cam.resolutionY;
+    next.samples = gridSide * gridSide;
+    next.renderKey = renderKey(config, next.width, next.height, next.samples);
+    next.geometryKey = geometryKey(config.inputScene, scene);
+    std::map<std::string, uint64_t> textures;
+    for (const Shape* s : scene.objects) next.materialKeys.push_back(materialKey(s->material, textures));
+    for (const Light& l : scene.lights) next.lightKeys.push_back(lightKey(l));
+
+    GBuffer cached;
+    std::string reason;
+    {
+        TRACE_SCOPE("readGBuffer");
+        if (!cached.read(config.gbufferFile)) reason = "no G-buffer yet";
+        else if (cached.renderKey != next.renderKey) reason = "render settings changed";
+        else if (cached.geometryKey != next.geometryKey || cached.materialKeys.size() != next.materialKeys.size())
+            reason = "geometry or camera changed";
+        else if (cached.lightKeys.size() != next.lightKeys.size()) reason = "lights added or removed";
+    }
+
+    size_t pixels = (size_t)next.width * next.height;
+    if (!reason.empty()) {
+        std::cout << "G-buffer: full render, " << reason << "\n";
+        next.radiance.assign(pixels, Vector3(0, 0, 0));
+        next.touched.assign(pixels, 0);
+        next.hits.resize(pixels * next.samples);
+        tracer.render(img, next, nullptr, false);
+    } else {
+        // Objects are told apart by bit (index & 63), so this can only over-select
+        uint64_t changed = 0;
+        int materials = 0, lights = 0;
+        for (size_t i = 0; i < next.materialKeys.size(); ++i) {
+            if (next.materialKeys[i] != cached.materialKeys[i]) {
+                changed |= 1ull << (i & 63);
+                materials++;
+            }
+        }
+        for (size_t i = 0; i < next.lightKeys.size(); ++i) {
+            if (next.lightKeys[i] != cached.lightKeys[i]) lights++;
+        }
+
+        // Every shaded hit samples every light, so light edits reach all pixels that hit something
+        bool lightsMatter = lights > 0 && !config.noShading;
+        std::vector<unsigned char> reshade(pixels);
+        size_t affected = 0;
+        for (size_t i = 0; i < pixels; ++i) {
+            reshade[i] = (cached.touched[i] & changed) != 0 || (lightsMatter && cached.touched[i] != 0);
+            affected += reshade[i];
+        }
+        std::cout << "G-buffer: " << materials << " materials and " << lights << " lights changed, re-shading "
+                  << affected << " of " << pixels << " pixels (" << 100.0 * affected / std::max<size_t>(pixels, 1) << " %)\n";
+
+        next.radiance = std::move(cached.radiance);
+        next.touched = std::move(cached.touched);
+        next.hits = std::move(cached.hits);
+        tracer.render(img, next, reshade.data(), true);
+    }
+
+    TRACE_SCOPE("writeGBuffer");
+    if (!next.write(config.gbufferFile)) {
+        std::cerr << "\nFailed to write G-buffer " << config.gbufferFile << "\n";
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "maths.h"
+#include "scene.h"
+#include "config.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Raytracer;
+class Image;
+
+// Primary hit of one camera sample
+struct GSample {
+    int32_t object = -1;        // index into Scene::objects, -1 for a miss
+    float t = 0.0f;
+    Vector3 point;
+    Vector3 normal;
+    float u = 0.0f, v = 0.0f;
+    uint64_t seed = 0;          // sampleSeed of the sample
+};
+
+// --gbuffer file: primary hits, final radiance and the objects each pixel's
+// ray tree touched, with keys to tell what changed since it was written
+struct GBuffer {
+    int width = 0;
+    int height = 0;
+    int samples = 0;                    // per pixel, gridSide^2
+    uint64_t renderKey = 0;             // settings that change radiance
+    uint64_t geometryKey = 0;           // scene file without materials and lights, plus mesh file contents
+    std::vector<uint64_t> materialKeys; // per object
+    std::vector<uint64_t> lightKeys;    // per light
+
+    std::vector<Vector3> radiance;      // per pixel, linear
+    std::vector<uint64_t> touched;      // per pixel, bit (object & 63) per object hit by any of its rays
+    std::vector<GSample> hits;          // per sample, pixel-major
+
+    bool read(const std::string& filename);
+    bool write(const std::string& filename) const;
+};
+
+// Renders img through the G-buffer in config.gbufferFile: reuses it where
+// only materials or lights changed and re-shades just the pixels whose rays
+// touched them, otherwise renders everything. Writes the updated file.
+void renderIncremental(const Raytracer& tracer, const Scene& scene, const Camera& cam,
+                       const RenderConfig& config, Image& img);
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "shapes/shape.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Uniform grid over the scene, traversed with 3D-DDA
+// (Amanatides & Woo, "A Fast Voxel Traversal Algorithm for Ray Tracing")
+class UniformGrid : public Shape {
+public:
+    AABB box;
+    int res[3];
+    Vector3 cellSize;
+    Vector3 invCellSize;
+
+    std::vector<const Shape*> prims;     // shapes, indexed by cellPrims
+    std::vector<unsigned> cellStart;     // cell i owns cellPrims[cellStart[i] .. cellStart[i+1])
+    std::vector<unsigned> cellPrims;
+
+    // density = target cells per primitive
+    UniformGrid(const std::vector<Shape*>& shapes, float density = 4.0f)
+        : prims(shapes.begin(), shapes.end())
+    {
+        if (prims.empty()) {
+            res[0] = res[1] = res[2] = 1;
+            cellStart.assign(2, 0);
+            return;
+        }
+
+        std::vector<AABB> primBounds(prims.size());
+        for (size_t i = 0; i < prims.size(); ++i) {
+            primBounds[i] = prims[i]->bounds();
+            box.expand(primBounds[i]);
+        }
+
+        // Pad flat boxes so every axis has some thickness
+        Vector3 size = box.max - box.min;
+        float pad = 1e-4f * std::max(1.0f, std::max(size.x, std::max(size.y, size.z)));
+        box.min = box.min - Vector3(pad, pad, pad);
+        box.max = box.max + Vector3(pad, pad, pad);
+        size = box.max - box.min;
+
+        // Cell count proportional to primitive count, cells roughly cubic
+        float volume = size.x * size.y * size.z;
+        float cellsPerUnit = std::cbrt(density * prims.size() / volume);
+        const float extent[3] = { size.x, size.y, size.z };
+        for (int a = 0; a < 3; ++a) {
+            res[a] = std::clamp(static_cast<int>(extent[a] * cellsPerUnit), 1, MAX_RES);
+        }
+
+        cellSize = Vector3(size.x / res[0], size.y / res[1], size.z / res[2]);
+        invCellSize = Vector3(1.0f / cellSize.x, 1.0f / cellSize.y, 1.0f / cellSize.z);
+
+        // Count then fill the cell lists
+        size_t cells = (size_t)res[0] * res[1] * res[2];
+        cellStart.assign(cells + 1, 0);
+
+        for (int pass = 0; pass < 2; ++pass) {
+            std::vector<unsigned> cursor;
+            if (pass == 1) {
+                for (size_t c = 0; c < cells; ++c) cellStart[c + 1] += cellStart[c];
+                cellPrims.resize(cellStart[cells]);
+                cursor.assign(cellStart.begin(), cellStart.end() - 1);
+            }
+
+            for (size_t i = 0; i < prims.size(); ++i) {
+                int lo[3], hi[3];
+                cellRange(primBounds[i], lo, hi);
+
+                for (int z = lo[2]; z <= hi[2]; ++z)
+                    for (int y = lo[1]; y <= hi[1]; ++y)
+                        for (int x = lo[0]; x <= hi[0]; ++x) {
+                            size_t c = cellIndex(x, y, z);
+                            if (pass == 0) cellStart[c + 1]++;
+                            else cellPrims[cursor[c]++] = (unsigned)i;
+                        }
+            }
+        }
+    }
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+
+        // Clip ray to the grid box
+        const float o[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+        const float d[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+        const float lo[3] = { box.min.x, box.min.y, box.min.z };
+        const float hi[3] = { box.max.x, box.max.y, box.max.z };
+        const float cs[3] = { cellSize.x, cellSize.y, cellSize.z };
+
+        float tEnter = 0.0f;
+        float tExit = hit.t;
+        for (int a = 0; a < 3; ++a) {
+            float invD = 1.0f / d[a];
+            float t0 = (lo[a] - o[a]) * invD;
+            float t1 = (hi[a] - o[a]) * invD;
+            if (t0 > t1) std::swap(t0, t1);
+            tEnter = std::max(tEnter, t0);
+            tExit = std::min(tExit, t1);
+        }
+        if (!(tEnter <= tExit)) return false;
+
+        // DDA setup
+        int cell[3], step[3], stop[3];
+        float tNext[3], tDelta[3];
+        for (int a = 0; a < 3; ++a) {
+            float p = o[a] + d[a] * tEnter;
+            cell[a] = std::clamp(static_cast<int>((p - lo[a]) / cs[a]), 0, res[a] - 1);
+
+            if (d[a] > 0.0f) {
+                step[a] = 1;
+                stop[a] = res[a];
+                tNext[a] = tEnter + (lo[a] + (cell[a] + 1) * cs[a] - p) / d[a];
+                tDelta[a] = cs[a] / d[a];
+            } else if (d[a] < 0.0f) {
+                step[a] = -1;
+                stop[a] = -1;
+                tNext[a] = tEnter + (lo[a] + cell[a] * cs[a] - p) / d[a];
+                tDelta[a] = -cs[a] / d[a];
+            } else {
+                step[a] = 0;
+                stop[a] = -1;
+                tNext[a] = INFINITY;
+                tDelta[a] = INFINITY;
+            }
+        }
+
+        // Mailbox so shapes spanning several cells are tested once per ray
+        Mailbox& mb = mailbox();
+        if (mb.owner != this || mb.stamp.size() != prims.size() || ++mb.rayId == 0) {
+            mb.owner = this;
+            mb.stamp.assign(prims.size(), 0);
+            mb.rayId = 1;
+        }
+
+        bool found = false;
+        while (true) {
+            size_t c = cellIndex(cell[0], cell[1], cell[2]);
+            for (unsigned k = cellStart[c]; k < cellStart[c + 1]; ++k) {
+                unsigned i = cellPrims[k];
+                if (mb.stamp[i] == mb.rayId) continue;
+                mb.stamp[i] = mb.rayId;
+                found |= prims[i]->intersect(ray, hit);
+            }
+
+            // Next cell along the smallest tNext
+            int a = (tNext[0] < tNext[1]) ? ((tNext[0] < tNext[2]) ? 0 : 2)
+                                          : ((tNext[1] < tNext[2]) ? 1 : 2);
+
+            // A hit inside this cell cannot be beaten further along
+            if (hit.t <= tNext[a] || tNext[a] > tExit) break;
+
+            cell[a] += step[a];
+            if (cell[a] == stop[a]) break;
+            tNext[a] += tDelta[a];
+        }
+
+        return found;
+    }
+
+    AABB bounds() const override {
+        return box;
+    }
+
+    Vector3 centroid() const override {
+        return box.centre();
+    }
+
+private:
+    static const int MAX_RES = 128;
+
+    struct Mailbox {
+        const UniformGrid* owner = nullptr;
+        std::vector<unsigned> stamp;
+        unsigned rayId = 0;
+    };
+
+    static Mailbox& mailbox() {
+        thread_local Mailbox mb;
+        return mb;
+    }
+
+    size_t cellIndex(int x, int y, int z) const {
+        return ((size_t)z * res[1] + y) * res[0] + x;
+    }
+
+    void cellRange(const AABB& b, int lo[3], int hi[3]) const {
+        const float bmin[3] = { b.min.x - box.min.x, b.min.y - box.min.y, b.min.z - box.min.z };
+        const float bmax[3] = { b.max.x - box.min.x, b.max.y - box.min.y, b.max.z - box.min.z };
+        const float inv[3] = { invCellSize.x, invCellSize.y, invCellSize.z };
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::clamp(static_cast<int>(bmin[a] * inv[a]), 0, res[a] - 1);
+            hi[a] = std::clamp(static_cast<int>(bmax[a] * inv[a]), 0, res[a] - 1);
+        }
+    }
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "image.h"
+#include "trace.h"
 #include <iostream>
 #include <fstream>
 
@@ -27,8 +28,9 @@ void Image::setPixel(int x, int y, const Pixel& colour) {
 }
 
 // Write image to PPM file
-bool Image::writePPM(const std::string& filename) const {
+bool Image::writePPM(const std::string& filename, bool announce) const {
     std::ofstream file(filename);
+    if (!file) return false;
 
     file << "P3\n";
     file << width << " " << height << "\n";
@@ -42,13 +44,15 @@ bool Image::writePPM(const std::string& filename) const {
         file << "\n";
     }
 
-    file.close();
-    std::cout << "Image written to " << filename << std::endl;
+    file.close();     // flushes, so a full disk shows up here
+    if (!file) return false;
+    if (announce) std::cout << "Image written to " << filename << std::endl;
     return true;
 }
 
 // Read image from PPM file
 bool Image::readPPM(const std::string& filename) {
+    TRACE_SCOPE("readPPM");
     std::ifstream file(filename);
 
     std::string magic;
@@ -73,3 +77,36 @@ bool Image::readPPM(const std::string& filename) {
     file.close();
     return true;
 }
+
+// Write floats as little-endian PFM
+bool writePFM(const std::string& filename, const std::vector<float>& values, int width, int height, int channels) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) return false;
+
+    size_t row = (size_t)width * channels;
+    file << (channels == 3 ? "PF" : "Pf") << "\n" << width << " " << height << "\n-1.0\n";
+    for (int y = height - 1; y >= 0; y--) {
+        file.write(reinterpret_cast<const char*>(&values[y * row]), row * sizeof(float));
+    }
+    return (bool)file;
+}
+
+// Little-endian PFM only, as written above
+bool readPFM(const std::string& filename, std::vector<float>& values, int& width, int& height, int& channels) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) return false;
+
+    std::string magic;
+    float scale;
+    file >> magic >> width >> height >> scale;
+    file.get();
+    if (!file || (magic != "PF" && magic != "Pf") || scale >= 0.0f || width <= 0 || height <= 0) return false;
+
+    channels = (magic == "PF") ? 3 : 1;
+    size_t row = (size_t)width * channels;
+    values.resize(row * height);
+    for (int y = height - 1; y >= 0; y--) {
+        file.read(reinterpret_cast<char*>(&values[y * row]), row * sizeof(float));
+    }
+    return (bool)file;
+}
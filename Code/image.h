@@ -41,7 +41,7 @@ public:
 
     Pixel getPixel(int x, int y) const;
     void setPixel(int x, int y, const Pixel& color);
-    bool writePPM(const std::string& filename) const;
+    bool writePPM(const std::string& filename, bool announce = true) const;
     bool readPPM(const std::string& filename);
 
     int getWidth() const { return width; }
@@ -51,5 +51,9 @@ private:
     std::vector<Pixel> pixels;  
 };
 
+// Float image (PFM), 1 (grey) or 3 (RGB) interleaved channels, rows stored bottom to top
+bool writePFM(const std::string& filename, const std::vector<float>& values, int width, int height, int channels = 1);
+bool readPFM(const std::string& filename, std::vector<float>& values, int& width, int& height, int& channels);
+
 
 #endif
@@ -0,0 +1,188 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+// Minimal JSON reader for render-server jobs: objects, arrays, strings
+// (escapes except \u), numbers, true/false/null. Not a validator.
+
+namespace Json {
+
+struct Value {
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Value> array;
+    std::map<std::string, Value> object;
+
+    bool has(const std::string& key) const {
+        return type == Object && object.count(key) > 0;
+    }
+
+    // Member or a null value
+    const Value& operator[](const std::string& key) const {
+        static const Value none;
+        auto it = object.find(key);
+        return (type == Object && it != object.end()) ? it->second : none;
+    }
+
+    double num(double fallback) const { return type == Number ? number : fallback; }
+    std::string str(const std::string& fallback) const { return type == String ? string : fallback; }
+};
+
+class Parser {
+public:
+    explicit Parser(const std::string& text) : s(text) {}
+
+    // False with error set on malformed input, out is replaced
+    bool parse(Value& out) {
+        out = Value();
+        if (!value(out)) return false;
+        skip();
+        if (pos != s.size()) return fail("trailing characters");
+        return true;
+    }
+
+    std::string error;
+
+private:
+    const std::string& s;
+    size_t pos = 0;
+
+    bool fail(const char* what) {
+        error = std::string(what) + " at offset " + std::to_string(pos);
+        return false;
+    }
+
+    void skip() {
+        while (pos < s.size() && std::isspace((unsigned char)s[pos])) pos++;
+    }
+
+    bool literal(const char* word) {
+        size_t n = std::char_traits<char>::length(word);
+        if (s.compare(pos, n, word) != 0) return fail("unknown literal");
+        pos += n;
+        return true;
+    }
+
+    bool value(Value& v) {
+        skip();
+        if (pos >= s.size()) return fail("unexpected end");
+        char c = s[pos];
+        if (c == '{') return object(v);
+        if (c == '[') return array(v);
+        if (c == '"') {
+            v.type = Value::String;
+            return string(v.string);
+        }
+        if (c == 't' || c == 'f') {
+            v.type = Value::Bool;
+            v.boolean = (c == 't');
+            return literal(v.boolean ? "true" : "false");
+        }
+        if (c == 'n') {
+            v.type = Value::Null;
+            return literal("null");
+        }
+
+        const char* begin = s.c_str() + pos;
+        char* end = nullptr;
+        v.number = std::strtod(begin, &end);
+        if (end == begin) return fail("expected a value");
+        v.type = Value::Number;
+        pos += end - begin;
+        return true;
+    }
+
+    bool string(std::string& out) {
+        pos++;
+        while (pos < s.size() && s[pos] != '"') {
+            char c = s[pos++];
+            if (c == '\\' && pos < s.size()) {
+                char e = s[pos++];
+                switch (e) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    default:  out += e;    break;    // \" \\ \/
+                }
+            } else {
+                out += c;
+            }
+        }
+        if (pos >= s.size()) return fail("unterminated string");
+        pos++;
+        return true;
+    }
+
+    bool array(Value& v) {
+        v.type = Value::Array;
+        pos++;
+        skip();
+        if (pos < s.size() && s[pos] == ']') {
+            pos++;
+            return true;
+        }
+        for (;;) {
+            v.array.emplace_back();
+            if (!value(v.array.back())) return false;
+            skip();
+            if (pos < s.size() && s[pos] == ',') { pos++; continue; }
+            if (pos < s.size() && s[pos] == ']') { pos++; return true; }
+            return fail("expected , or ]");
+        }
+    }
+
+    bool object(Value& v) {
+        v.type = Value::Object;
+        pos++;
+        skip();
+        if (pos < s.size() && s[pos] == '}') {
+            pos++;
+            return true;
+        }
+        for (;;) {
+            skip();
+            if (pos >= s.size() || s[pos] != '"') return fail("expected a key");
+            std::string key;
+            if (!string(key)) return false;
+            skip();
+            if (pos >= s.size() || s[pos] != ':') return fail("expected :");
+            pos++;
+            if (!value(v.object[key])) return false;
+            skip();
+            if (pos < s.size() && s[pos] == ',') { pos++; continue; }
+            if (pos < s.size() && s[pos] == '}') { pos++; return true; }
+            return fail("expected , or }");
+        }
+    }
+};
+
+// Quoted and escaped for output
+inline std::string quote(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if ((unsigned char)c < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+} // namespace Json
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef LAZY_BVH_H
+#define LAZY_BVH_H
+
+#include "bvh_builder.h"
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+// Range of shapes whose BVH is built the first time a ray enters its box
+class DeferredBVH : public Shape {
+public:
+    std::vector<Shape*> shapes;     // not owned
+    AABB box;
+
+    DeferredBVH(std::vector<Shape*>&& s, const AABB& b) : shapes(std::move(s)), box(b) {}
+
+    ~DeferredBVH() override {
+        delete tree;
+    }
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        if (!box.intersect(ray, hit.t)) return false;
+
+        // Other threads wait here until the subtree is ready
+        std::call_once(once, [this] {
+            TRACE_SCOPE("deferred BVH", (int)shapes.size());
+            tree = BVHBuilder(1).build(shapes);
+            ready = true;
+        });
+        return tree->intersect(ray, hit);
+    }
+
+    bool built() const {
+        return ready;
+    }
+
+    size_t memoryBytes() const {
+        return sizeof(DeferredBVH) + shapes.capacity() * sizeof(Shape*) + (ready ? tree->memoryBytes() : 0);
+    }
+
+    AABB bounds() const override {
+        return box;
+    }
+
+    Vector3 centroid() const override {
+        return box.centre();
+    }
+
+private:
+    mutable std::once_flag once;
+    mutable BVHNode* tree = nullptr;
+    mutable std::atomic<bool> ready{false};
+};
+
+// BVH with only the top levels built up front
+// Ranges below eagerDepth become DeferredBVH leaves
+class LazyBVH : public Shape {
+public:
+    BVHNode* root = nullptr;
+    std::vector<DeferredBVH*> deferred;
+
+    LazyBVH(const std::vector<Shape*>& shapes, int threads, int eagerDepth = 8) {
+        std::mutex lock;
+        BVHBuilder builder(threads);
+        builder.setDefer(eagerDepth, [&](std::vector<Shape*>&& range, const AABB& box) -> Shape* {
+            DeferredBVH* d = new DeferredBVH(std::move(range), box);
+            std::lock_guard<std::mutex> guard(lock);
+            deferred.push_back(d);
+            return d;
+        });
+        root = builder.build(shapes);
+    }
+
+    ~LazyBVH() override {
+        delete root;
+        for (DeferredBVH* d : deferred) {
+            delete d;
+        }
+    }
+
+    // Deferred subtrees that rays have reached so far
+    size_t expanded() const {
+        size_t n = 0;
+        for (const DeferredBVH* d : deferred) {
+            if (d->built()) n++;
+        }
+        return n;
+    }
+
+    // Top levels plus the subtrees built so far
+    size_t memoryBytes() const {
+        size_t bytes = root ? root->memoryBytes() : 0;
+        for (const DeferredBVH* d : deferred) bytes += d->memoryBytes();
+        return bytes;
+    }
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        return root != nullptr && root->intersect(ray, hit);
+    }
+
+    AABB bounds() const override {
+        return root ? root->bounds() : AABB();
+    }
+
+    Vector3 centroid() const override {
+        return bounds().centre();
+    }
+};
+
+#endif
@@ -8,8 +8,15 @@
 #include "raytracer.h"
 #include "scene.h"
 #include "image.h"
-#include "BVH.h"
+#include "lazy_bvh.h"
+#include "accel.h"
 #include "config.h" 
+#include "trace.h"
+#include "memory.h"
+#include "server.h"
+#include "distributed.h"
+#include "preview.h"
+#include "gbuffer.h"
 
 void printUsage(const char* progName) {
     std::cout << "Usage: " << progName << " [options]\n"
@@ -20,7 +27,33 @@ void printUsage(const char* progName) {
               << "  -h <int>         Output height (overrides scene)\n"
               << "  -spp <int>       Samples per pixel (default: 1)\n"
               << "  -d <int>         Max recursion depth (default: 3)\n"
-              << "  -no-bvh          Disable BVH acceleration\n"
+              << "  -no-bvh          Disable acceleration (test every shape)\n"
+              << "  -accel <type>    Acceleration structure: 'bvh', 'grid' (default: bvh)\n"
+              << "  -bvh-build <mode> BVH builder: 'median', 'binned', 'sbvh' (default: binned)\n"
+              << "  -build-threads <int> Threads for BVH construction (default: all cores)\n"
+              << "  -bvh-layout <layout> BVH nodes: 'full', 'compact' (default: full)\n"
+              << "  -bvh-lazy        Build the lower BVH levels when rays first reach them;\n"
+              << "                   always binned and full layout, overrides -bvh-build and -bvh-layout\n"
+              << "  -heatmap <mode>  Also write a per-pixel cost image: 'time', 'rays'\n"
+              << "  --capture-rays <file> Record every traced ray for Bench/replay\n"
+              << "  --trace <file>   Write a Chrome trace-event timeline (chrome://tracing, Perfetto)\n"
+              << "  --mem-report     Print memory use by subsystem after load, after the build and at exit\n"
+              << "  --mem-budget <MB> Stop with an error instead of growing past MB resident (not with --serve)\n"
+              << "  --stats <file>   Write ray and traversal counters as JSON (build with make STATS=1)\n"
+              << "  -seed <int>      Seed of the per-sample random streams (default: 1337)\n"
+              << "  --serve <socket> Run as a render server on a Unix socket (see README)\n"
+              << "  -threads <int>   Server and preview render threads, or worker connections (default: all cores)\n"
+              << "  --cache-scenes <int> Scenes the server keeps loaded (default: 4)\n"
+              << "  --coordinator <port> Render by handing tiles to --worker processes (0 = any port)\n"
+              << "  --spawn-workers <int> Local worker processes started by the coordinator\n"
+              << "  --worker <host:port> Render tiles for a coordinator, one connection per -threads\n"
+              << "  -tile <int>      Coordinator tile size in pixels (default: 32)\n"
+              << "  --preview        Render 1/16, 1/4, then full resolution, then add samples up to -spp;\n"
+              << "                   rewrites the output each step and restarts on camera edits\n"
+              << "  -crop <x0> <y0> <x1> <y1> Render only this window, in pixels or as fractions (0.25 0.25 0.75 0.75)\n"
+              << "  --crop-into <file> Composite the crop into this PPM of the full frame instead of writing it alone\n"
+              << "  --gbuffer <file> Keep primary hits in this file; later runs with only material or light\n"
+              << "                   edits re-shade just the pixels whose rays touched them\n"
               << "  -no-shading      Disable lighting calculations (flat color only)\n"
               << "  --shadow-samples <int> Number of shadow rays for distributed RT\n"
               << "  --glossy-samples <int> Number of reflection rays for glossy materials\n"
@@ -82,6 +115,111 @@ RenderConfig parseArguments(int argc, char* argv[]) {
         else if (strcmp(argv[i], "-no-bvh") == 0) {
             config.useBVH = false;
         }
+        else if (strcmp(argv[i], "-accel") == 0 && i + 1 < argc) {
+            std::string type = argv[++i];
+            if (type == "bvh") {
+                config.accel = AccelType::BVH;
+            } else if (type == "grid") {
+                config.accel = AccelType::Grid;
+            } else {
+                std::cerr << "Unknown acceleration structure: " << type << ". Using default (BVH).\n";
+            }
+        }
+        else if (strcmp(argv[i], "-bvh-build") == 0 && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "median") {
+                config.bvhBuild = BVHBuildMode::Median;
+            } else if (mode == "binned") {
+                config.bvhBuild = BVHBuildMode::Binned;
+            } else if (mode == "sbvh") {
+                config.bvhBuild = BVHBuildMode::Spatial;
+            } else {
+                std::cerr << "Unknown BVH builder: " << mode << ". Using default (binned).\n";
+            }
+        }
+        else if (strcmp(argv[i], "-bvh-layout") == 0 && i + 1 < argc) {
+            std::string layout = argv[++i];
+            if (layout == "full") {
+                config.bvhLayout = BVHLayout::Full;
+            } else if (layout == "compact") {
+                config.bvhLayout = BVHLayout::Compact;
+            } else {
+                std::cerr << "Unknown BVH layout: " << layout << ". Using default (full).\n";
+            }
+        }
+        else if (strcmp(argv[i], "-heatmap") == 0 && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "time") {
+                config.heatmap = HeatmapMode::Time;
+            } else if (mode == "rays") {
+                config.heatmap = HeatmapMode::Rays;
+            } else {
+                std::cerr << "Unknown heatmap mode: " << mode << ". Use 'time' or 'rays'.\n";
+            }
+        }
+        else if (strcmp(argv[i], "--capture-rays") == 0 && i + 1 < argc) {
+            config.captureFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            config.traceFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--mem-report") == 0) {
+            config.memReport = true;
+        }
+        else if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc) {
+            config.memBudgetMB = std::stoul(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            config.statsFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "-bvh-lazy") == 0) {
+            config.lazyBVH = true;
+        }
+        else if (strcmp(argv[i], "-build-threads") == 0 && i + 1 < argc) {
+            config.buildThreads = std::stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            config.seed = std::stoull(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            config.serveSocket = argv[++i];
+        }
+        else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            config.renderThreads = std::stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cache-scenes") == 0 && i + 1 < argc) {
+            config.cacheScenes = std::stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--coordinator") == 0 && i + 1 < argc) {
+            config.coordinatorPort = std::stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--spawn-workers") == 0 && i + 1 < argc) {
+            config.spawnWorkers = std::stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--worker") == 0 && i + 1 < argc) {
+            config.workerOf = argv[++i];
+        }
+        else if (strcmp(argv[i], "-tile") == 0 && i + 1 < argc) {
+            config.tileSize = std::stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--preview") == 0) {
+            config.preview = true;
+        }
+        else if (strcmp(argv[i], "-crop") == 0 && i + 4 < argc) {
+            // Fractions when any value has a decimal point
+            config.crop = true;
+            for (int k = 0; k < 4; ++k) {
+                const char* value = argv[++i];
+                if (strchr(value, '.')) config.cropNormalized = true;
+                config.cropWindow[k] = std::stof(value);
+            }
+        }
+        else if (strcmp(argv[i], "--crop-into") == 0 && i + 1 < argc) {
+            config.cropInto = argv[++i];
+        }
+        else if (strcmp(argv[i], "--gbuffer") == 0 && i + 1 < argc) {
+            config.gbufferFile = argv[++i];
+        }
         else if (strcmp(argv[i], "-no-shading") == 0) {
             config.noShading = true;
         }
@@ -107,21 +245,66 @@ RenderConfig parseArguments(int argc, char* argv[]) {
                 }
         }
     }
+
+    // The lazy BVH only has binned splits and full nodes
+    if (config.lazyBVH && (config.bvhBuild != BVHBuildMode::Binned || config.bvhLayout != BVHLayout::Full)) {
+        std::cerr << "-bvh-lazy always builds binned, full-layout nodes. Ignoring -bvh-build and -bvh-layout.\n";
+        config.bvhBuild = BVHBuildMode::Binned;
+        config.bvhLayout = BVHLayout::Full;
+    }
     return config;
 }
 
 
+
+// -crop in pixels of a width x height frame, false when empty or outside it
+bool cropWindow(const RenderConfig& config, int width, int height, Tile& window) {
+    const float* c = config.cropWindow;
+    if (config.cropNormalized) {
+        window = Tile{ (int)std::floor(c[0] * width), (int)std::floor(c[1] * height),
+                       (int)std::ceil(c[2] * width), (int)std::ceil(c[3] * height) };
+    } else {
+        window = Tile{ (int)c[0], (int)c[1], (int)c[2], (int)c[3] };
+    }
+    window.x0 = std::max(window.x0, 0);
+    window.y0 = std::max(window.y0, 0);
+    window.x1 = std::min(window.x1, width);
+    window.y1 = std::min(window.y1, height);
+    return window.x0 < window.x1 && window.y0 < window.y1;
+}
+
+
 int main(int argc, char* argv[]) {
 
     // Set random seed
     srand(static_cast<unsigned int>(time(nullptr)));
     
     RenderConfig config = parseArguments(argc, argv);
+    if (!config.traceFile.empty()) Trace::enable();
+    Memory::budget() = config.memBudgetMB * 1024 * 1024;
+    if (config.memBudgetMB > 0 && Memory::currentRSS() == 0) {
+        std::cerr << "Warning: resident size is not readable on this platform (no /proc/self/statm), --mem-budget has no effect\n";
+    }
+    if (!config.serveSocket.empty()) {
+        // An overrun exits the process, which would take every client's job down with it
+        if (config.memBudgetMB > 0) {
+            std::cerr << "Error: --mem-budget exits the process on overrun and cannot be combined with --serve\n";
+            return 1;
+        }
+        return runServer(config);
+    }
+    if (!config.workerOf.empty()) return runWorker(config);
 
     std::cout << "========================================\n";
     std::cout << "Scene:      " << config.inputScene << "\n";
     std::cout << "Output:     " << config.outputImage << "\n";
-    std::cout << "BVH:        " << (config.useBVH ? "Enabled" : "Disabled") << "\n";
+    std::cout << "Accel:      ";
+    if (!config.useBVH) std::cout << "None";
+    else if (config.accel == AccelType::Grid) std::cout << "Grid";
+    else if (config.lazyBVH) std::cout << "BVH (lazy)";
+    else if (config.bvhLayout == BVHLayout::Compact) std::cout << "BVH (compact)";
+    else std::cout << "BVH";
+    std::cout << "\n";
     std::cout << "Depth:      " << config.maxDepth << "\n";
     std::cout << "AA Samples: " << config.samplesPerPixel << "\n";
     std::cout << "Exposure:   " << config.exposure << "\n";
@@ -134,6 +317,9 @@ int main(int argc, char* argv[]) {
 
     std::cout << "========================================\n";
 
+    if (config.coordinatorPort >= 0) return runCoordinator(config);
+    if (config.preview) return runPreview(config);
+
     Camera cam;
     Scene scene;
 
@@ -147,24 +333,55 @@ int main(int argc, char* argv[]) {
     if (config.width > 0) cam.resolutionX = config.width;
     if (config.height > 0) cam.resolutionY = config.height;
 
+    Memory::check("scene load");
+    if (config.memReport) Memory::print("after load", Memory::measure(scene, nullptr, nullptr));
+
+    // Build acceleration structures
+    auto build_start = std::chrono::high_resolution_clock::now();
+    AccelReport built;
+    Shape* accel = buildAcceleration(scene, config, &built);
 
-    // Build BVH
-    BVHNode* bvh_root = nullptr;
-    if (config.useBVH) {
-        std::cout << "Building BVH for " << scene.shapes.size() << " primitives...\n";
-       
-        bvh_root = new BVHNode(scene.shapes, 0, scene.shapes.size());
+    std::chrono::duration<double> build_elapsed = std::chrono::high_resolution_clock::now() - build_start;
+    std::cout << "Build Time: " << build_elapsed.count() << " seconds ("
+              << built.primitives / std::max(build_elapsed.count(), 1e-9) / 1e6 << " M primitives/s)\n";
+    if (built.bvhBytes > 0) {
+        std::cout << "BVH Memory: " << built.bvhBytes / 1024.0 << " KB\n";
+    }
+    Memory::check("acceleration build");
+    if (config.memReport) Memory::print("after BVH build", Memory::measure(scene, accel, nullptr));
+
+    // Crop window, the whole frame without -crop
+    Tile window{ 0, 0, cam.resolutionX, cam.resolutionY };
+    if (config.crop && !cropWindow(config, cam.resolutionX, cam.resolutionY, window)) {
+        std::cerr << "Error: Crop window is empty or outside the " << cam.resolutionX << "x" << cam.resolutionY << " frame\n";
+        return 1;
+    }
+    if (config.crop && !config.gbufferFile.empty()) {
+        std::cerr << "Error: --gbuffer covers the whole frame and cannot be combined with -crop\n";
+        return 1;
     }
 
     // Initialise renderer
-    Raytracer tracer(&cam, &scene, bvh_root, config);
-    Image img(cam.resolutionX, cam.resolutionY);
+    Memory::check("image allocation", (size_t)cam.resolutionX * cam.resolutionY * sizeof(Pixel));
+    Raytracer tracer(&cam, &scene, accel, config);
+    Image img = config.cropInto.empty() ? Image(cam.resolutionX, cam.resolutionY) : Image(config.cropInto);
+    if (img.getWidth() != cam.resolutionX || img.getHeight() != cam.resolutionY) {
+        std::cerr << "Error: " << config.cropInto << " is " << img.getWidth() << "x" << img.getHeight()
+                  << ", the frame is " << cam.resolutionX << "x" << cam.resolutionY << "\n";
+        return 1;
+    }
     
     // Render Loop
-    std::cout << "Rendering started at " << cam.resolutionX << "x" << cam.resolutionY << "...\n";
+    if (config.crop) {
+        std::cout << "Rendering crop [" << window.x0 << ", " << window.x1 << ") x [" << window.y0 << ", " << window.y1
+                  << ") of " << cam.resolutionX << "x" << cam.resolutionY << "...\n";
+    } else {
+        std::cout << "Rendering started at " << cam.resolutionX << "x" << cam.resolutionY << "...\n";
+    }
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    tracer.render(img); 
+    if (!config.gbufferFile.empty()) renderIncremental(tracer, scene, cam, config, img);
+    else tracer.render(img, window);
 
     auto end_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end_time - start_time;
@@ -172,13 +389,65 @@ int main(int argc, char* argv[]) {
     std::cout << "Render Complete\n";
     std::cout << "Time Taken: " << elapsed.count() << " seconds\n";
 
-    if (img.writePPM(config.outputImage)) {
-        std::cout << "Saved to " << config.outputImage << "\n";
-    } else {
-        std::cerr << "Failed to save image!\n";
+#ifdef RT_STATS
+    Stats::print(elapsed.count());
+    if (!config.statsFile.empty()) {
+        if (Stats::writeJSON(config.statsFile, elapsed.count())) {
+            std::cout << "Statistics written to " << config.statsFile << "\n";
+        } else {
+            std::cerr << "Failed to write statistics to " << config.statsFile << "\n";
+        }
+    }
+#else
+    if (!config.statsFile.empty()) {
+        std::cerr << "Statistics are compiled out, rebuild with make STATS=1\n";
+    }
+#endif
+
+    if (config.lazyBVH) {
+        size_t expanded = 0, deferred = 0;
+        std::vector<const Shape*> bvhs = { accel };
+        for (auto& m : scene.meshes) bvhs.push_back(m.second->bvh);
+        for (const Shape* s : bvhs) {
+            if (auto* lazy = dynamic_cast<const LazyBVH*>(s)) {
+                expanded += lazy->expanded();
+                deferred += lazy->deferred.size();
+            }
+        }
+        std::cout << "Lazy BVH: built " << expanded << " of " << deferred << " deferred subtrees\n";
+    }
+
+    // Crop alone unless compositing
+    if (config.crop && config.cropInto.empty()) {
+        Image cropped(window.x1 - window.x0, window.y1 - window.y0);
+        for (int y = window.y0; y < window.y1; ++y) {
+            for (int x = window.x0; x < window.x1; ++x) {
+                cropped.setPixel(x - window.x0, y - window.y0, img.getPixel(x, y));
+            }
+        }
+        img = cropped;
+    }
+
+    {
+        TRACE_SCOPE("writePPM");
+        if (img.writePPM(config.outputImage)) {
+            std::cout << "Saved to " << config.outputImage << "\n";
+        } else {
+            std::cerr << "Failed to save image!\n";
+        }
     }
 
-    if (bvh_root) delete bvh_root;
+    if (config.memReport) Memory::print("at exit", Memory::measure(scene, accel, &img));
+
+    if (accel) delete accel;
+
+    if (!config.traceFile.empty()) {
+        if (Trace::write(config.traceFile)) {
+            std::cout << "Trace written to " << config.traceFile << "\n";
+        } else {
+            std::cerr << "Failed to write trace to " << config.traceFile << "\n";
+        }
+    }
     
     return 0;
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
 
 #include <cmath>
 #include <algorithm>
-#include <random>
+#include <cstdint>
 
 // --- VECTOR 3 ---
 struct Vector3 {
@@ -78,9 +78,10 @@ struct Vector3 {
 struct Ray {
     Vector3 origin;
     Vector3 direction;
+    float time = 0.0f;      // shutter time in [0, 1], for motion blur
 
     Ray() {}
-    Ray(Vector3 o, Vector3 d) : origin(o), direction(d) {}
+    Ray(Vector3 o, Vector3 d, float t = 0.0f) : origin(o), direction(d), time(t) {}
 
 };
 
@@ -161,11 +162,50 @@ struct Matrix3 {
 
 };
 
-// Random number generator
-[[maybe_unused]] static float randomFloat() {
-    static std::mt19937 generator(1337); 
-    static std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
-    return distribution(generator);
+// Random number generator, PCG32 (O'Neill, "PCG: A Family of Simple Fast
+// Space-Efficient Statistically Good Algorithms for Random Number Generation")
+// One per thread; the renderer reseeds it for every camera sample, so a
+// pixel's noise doesn't depend on the thread or order it was rendered in
+struct Random {
+    uint64_t state = 0x853c49e6748fea9bULL;
+
+    void seed(uint64_t s) {
+        state = 0;
+        next();
+        state += s;
+        next();
+    }
+
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot = static_cast<uint32_t>(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+    }
+};
+
+inline Random& threadRandom() {
+    thread_local Random generator;
+    return generator;
+}
+
+// Uniform in [0, 1)
+inline float randomFloat() {
+    return (threadRandom().next() >> 8) * (1.0f / 16777216.0f);
+}
+
+inline void seedRandom(uint64_t seed) {
+    threadRandom().seed(seed);
+}
+
+// Seed of one camera sample from the frame seed and its pixel (SplitMix64 finaliser)
+inline uint64_t sampleSeed(uint64_t frameSeed, int x, int y, int sample) {
+    uint64_t z = frameSeed + 0x9e3779b97f4a7c15ULL * (((uint64_t)(uint32_t)y << 32 | (uint32_t)x) + 1)
+                           + 0xbf58476d1ce4e5b9ULL * (uint64_t)(sample + 1);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
 }
 
 inline float clampf(float x, float minVal, float maxVal) {
@@ -0,0 +1,141 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "budget.h"
+#include "scene.h"
+#include "image.h"
+#include "BVH.h"
+#include "compact_bvh.h"
+#include "lazy_bvh.h"
+#include "shapes/sphere.h"
+#include "shapes/sphereset.h"
+#include "shapes/cube.h"
+#include "shapes/plane.h"
+#include "shapes/triangle.h"
+#include "shapes/instance.h"
+#include "shapes/moving.h"
+#include <iostream>
+#include <iomanip>
+#include <set>
+#include <vector>
+
+// Memory footprint by subsystem (--mem-report); the --mem-budget check that
+// stops the program with a message before the OOM killer is in budget.h
+// Sizes are measured by walking the scene, so nothing is added to allocations
+
+namespace Memory {
+
+enum Category {
+    MEM_SHAPES,         // scene.shapes objects, materials included
+    MEM_MATERIALS,      // the Material part of the above
+    MEM_MESHES,         // object-space triangles
+    MEM_TEXTURES,
+    MEM_BVH,            // all levels, grid excluded
+    MEM_IMAGE,          // output framebuffer
+    MEM_COUNT
+};
+
+inline const char* name(int category) {
+    static const char* names[MEM_COUNT] = {
+        "shapes", "  of which materials", "mesh triangles", "textures", "BVH nodes", "output image"
+    };
+    return names[category];
+}
+
+// Size of one scene object, dynamic type first
+inline size_t shapeBytes(const Shape* s) {
+    if (auto* set = dynamic_cast<const SphereSet*>(s)) {
+        size_t bytes = sizeof(SphereSet);
+        for (int i = 0; i < set->count; ++i) bytes += shapeBytes(set->spheres[i]);
+        return bytes;
+    }
+    if (auto* moving = dynamic_cast<const MovingShape*>(s)) return sizeof(MovingShape) + shapeBytes(moving->shape);
+    if (dynamic_cast<const UniformSphere*>(s)) return sizeof(UniformSphere);
+    if (dynamic_cast<const AxisAlignedSphere*>(s)) return sizeof(AxisAlignedSphere);
+    if (dynamic_cast<const Sphere*>(s)) return sizeof(Sphere);
+    if (dynamic_cast<const AxisAlignedCube*>(s)) return sizeof(AxisAlignedCube);
+    if (dynamic_cast<const Cube*>(s)) return sizeof(Cube);
+    if (dynamic_cast<const Plane*>(s)) return sizeof(Plane);
+    if (dynamic_cast<const Triangle*>(s)) return sizeof(Triangle);
+    if (dynamic_cast<const MeshInstance*>(s)) return sizeof(MeshInstance);
+    return sizeof(Shape);
+}
+
+// Materials embedded in a shape, counting the members of packed sets
+inline size_t materialBytes(const Shape* s) {
+    size_t bytes = sizeof(Material) + s->material.textureName.capacity();
+    if (auto* set = dynamic_cast<const SphereSet*>(s)) {
+        for (int i = 0; i < set->count; ++i) bytes += materialBytes(set->spheres[i]);
+    }
+    if (auto* moving = dynamic_cast<const MovingShape*>(s)) bytes += materialBytes(moving->shape);
+    return bytes;
+}
+
+// Node memory of any BVH main.cpp can build
+inline size_t bvhBytes(const Shape* bvh) {
+    if (auto* compact = dynamic_cast<const CompactBVH*>(bvh)) return compact->memoryBytes();
+    if (auto* node = dynamic_cast<const BVHNode*>(bvh)) return node->memoryBytes();
+    if (auto* lazy = dynamic_cast<const LazyBVH*>(bvh)) return lazy->memoryBytes();
+    return 0;
+}
+
+struct Report {
+    size_t bytes[MEM_COUNT] = {};
+    size_t shapes = 0;
+    size_t triangles = 0;
+    size_t textures = 0;
+};
+
+// accel may be null (before the build or without a BVH), img may be null
+inline Report measure(const Scene& scene, const Shape* accel, const Image* img) {
+    Report r;
+    std::set<const Image*> textures;
+
+    for (const Shape* s : scene.shapes) {
+        r.bytes[MEM_SHAPES] += shapeBytes(s) + sizeof(Shape*);
+        r.bytes[MEM_MATERIALS] += materialBytes(s);
+        if (s->material.texture) textures.insert(s->material.texture);
+        r.shapes++;
+    }
+    for (const auto& m : scene.meshes) {
+        r.bytes[MEM_MESHES] += m.second->triangles.size() * sizeof(Triangle)
+                             + m.second->triangles.capacity() * sizeof(Shape*);
+        r.triangles += m.second->triangles.size();
+        r.bytes[MEM_BVH] += bvhBytes(m.second->bvh);
+    }
+    for (const Image* t : textures) {
+        r.bytes[MEM_TEXTURES] += (size_t)t->getWidth() * t->getHeight() * sizeof(Pixel);
+    }
+    r.textures = textures.size();
+
+    r.bytes[MEM_BVH] += bvhBytes(accel);
+    if (img) r.bytes[MEM_IMAGE] = (size_t)img->getWidth() * img->getHeight() * sizeof(Pixel);
+    return r;
+}
+
+inline void print(const char* stage, const Report& r) {
+    size_t tracked = 0;
+    for (int i = 0; i < MEM_COUNT; ++i) {
+        if (i != MEM_MATERIALS) tracked += r.bytes[i];
+    }
+
+    std::cout << "Memory " << stage << ":\n" << std::fixed << std::setprecision(2);
+    for (int i = 0; i < MEM_COUNT; ++i) {
+        std::cout << "  " << std::left << std::setw(22) << name(i) << std::right << std::setw(10) << mb(r.bytes[i]) << " MB";
+        if (i == MEM_SHAPES) std::cout << "  (" << r.shapes << " objects)";
+        if (i == MEM_MESHES) std::cout << "  (" << r.triangles << " triangles)";
+        if (i == MEM_TEXTURES) std::cout << "  (" << r.textures << " images)";
+        std::cout << "\n";
+    }
+    std::cout << "  " << std::left << std::setw(22) << "tracked total" << std::right << std::setw(10) << mb(tracked) << " MB\n"
+              << "  " << std::left << std::setw(22) << "resident (RSS)" << std::right << std::setw(10) << mb(currentRSS()) << " MB\n"
+              << "  " << std::left << std::setw(22) << "peak RSS" << std::right << std::setw(10) << mb(peakRSS()) << " MB\n";
+    if (budget() > 0) {
+        std::cout << "  " << std::left << std::setw(22) << "budget" << std::right << std::setw(10) << mb(budget()) << " MB\n";
+    }
+    std::cout << std::defaultfloat;
+}
+
+} // namespace Memory
+
+#endif
@@ -0,0 +1,192 @@
+#include "preview.h"
+#include "raytracer.h"
+#include "scene.h"
+#include "image.h"
+#include "accel.h"
+#include "threadpool.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+static const int BAND_ROWS = 8;
+static const int PASS_SPP = 4;          // samples added per refinement pass, a 2x2 grid
+
+static double since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Fields of the scene file's camera block
+static bool sameCamera(const Camera& a, const Camera& b) {
+    auto same = [](const Vector3& u, const Vector3& v) { return u.x == v.x && u.y == v.y && u.z == v.z; };
+    return same(a.location, b.location) && same(a.gaze, b.gaze) && same(a.cameraUp, b.cameraUp)
+        && same(a.velocity, b.velocity) && a.focalLength == b.focalLength && a.sensorWidth == b.sensorWidth
+        && a.sensorHeight == b.sensorHeight && a.aperture == b.aperture && a.focalDistance == b.focalDistance
+        && a.resolutionX == b.resolutionX && a.resolutionY == b.resolutionY;
+}
+
+// Renders the whole frame of tracer's camera in row bands on the pool.
+// Polls cancel while waiting; false if it fired before the frame was done.
+static bool renderFrame(ThreadPool& pool, const Raytracer& tracer, Image& img, std::vector<Vector3>& radiance,
+                        const std::function<bool()>& cancel) {
+    struct Progress {
+        std::atomic<int> next{0};
+        std::atomic<bool> stop{false};
+        std::mutex lock;
+        std::condition_variable finished;
+        int running = 0;
+    } progress;
+
+    int bands = (img.getHeight() + BAND_ROWS - 1) / BAND_ROWS;
+    progress.running = std::min(bands, pool.size());
+    for (int i = 0, n = progress.running; i < n; ++i) {
+        pool.submit([&] {
+            for (int band; !progress.stop && (band = progress.next++) < bands;) {
+                Tile tile{ 0, band * BAND_ROWS, img.getWidth(), std::min(img.getHeight(), (band + 1) * BAND_ROWS) };
+                tracer.renderTile(img, tile, radiance.data());
+            }
+            std::lock_guard<std::mutex> guard(progress.lock);
+            if (--progress.running == 0) progress.finished.notify_all();
+        });
+    }
+
+    // Tasks reference progress, so wait for them even when cancelling
+    std::unique_lock<std::mutex> guard(progress.lock);
+    while (progress.running > 0) {
+        if (!progress.finished.wait_for(guard, std::chrono::milliseconds(50), [&] { return progress.running == 0; })) {
+            guard.unlock();
+            if (!progress.stop && cancel()) progress.stop = true;
+            guard.lock();
+        }
+    }
+    return !progress.stop;
+}
+
+// Written beside the output and renamed over it, so viewers never read half an image
+static void publish(const Image& img, const std::string& path) {
+    std::string partial = path + ".part";
+    if (!img.writePPM(partial, false) || std::rename(partial.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write " << path << "\n";
+    }
+}
+
+int runPreview(const RenderConfig& config) {
+    Camera cam;
+    Scene scene;
+    if (!loadScene(config.inputScene, cam, scene)) {
+        std::cerr << "Error: Scene failed to load: " << config.inputScene << "\n";
+        return 1;
+    }
+    Shape* accel = buildAcceleration(scene, config);
+    ThreadPool pool(config.renderThreads);
+
+    std::error_code ec;
+    auto modified = std::filesystem::last_write_time(config.inputScene, ec);
+    Camera fileCamera = cam;        // as read, before -w/-h
+
+    // Re-reads only the camera block when the scene file changes
+    auto cameraEdited = [&]() {
+        auto now = std::filesystem::last_write_time(config.inputScene, ec);
+        if (ec || now == modified) return false;
+        modified = now;
+
+        Camera edited;
+        if (!edited.readFromFile(config.inputScene)) return false;
+        if (sameCamera(edited, fileCamera)) {
+            std::cout << "Scene edited outside the camera block, restart --preview to reload it\n";
+            return false;
+        }
+        fileCamera = edited;
+        return true;
+    };
+
+    for (;;) {
+        cam = fileCamera;
+        if (config.width > 0) cam.resolutionX = config.width;
+        if (config.height > 0) cam.resolutionY = config.height;
+        int width = cam.resolutionX, height = cam.resolutionY;
+
+        // A plain render takes floor(sqrt(spp))^2 samples, refine to exactly that
+        int side = std::max(1, static_cast<int>(std::sqrt(config.samplesPerPixel)));
+        int target = side * side;
+        std::cout << "Preview of " << config.inputScene << " at " << width << "x" << height << ", up to "
+                  << target << " spp (" << pool.size() << " threads)\n";
+
+        auto start = Clock::now();
+        bool restarted = false;
+
+        // Coarse levels at 1/16 and 1/4 of the pixels, then the full frame at 1 spp
+        for (int scale : { 4, 2, 1 }) {
+            Camera level = cam;
+            level.resolutionX = std::max(1, width / scale);
+            level.resolutionY = std::max(1, height / scale);
+
+            RenderConfig levelConfig = config;
+            levelConfig.samplesPerPixel = 1;
+            Raytracer tracer(&level, &scene, accel, levelConfig);
+            Image img(level.resolutionX, level.resolutionY);
+            std::vector<Vector3> radiance((size_t)level.resolutionX * level.resolutionY);
+
+            if (!renderFrame(pool, tracer, img, radiance, cameraEdited)) {
+                restarted = true;
+                break;
+            }
+            publish(img, config.outputImage);
+            std::cout << "  " << level.resolutionX << "x" << level.resolutionY << " 1 spp at " << since(start) * 1000.0 << " ms\n";
+        }
+
+        // Then passes of PASS_SPP samples, each with its own seed, averaged. Square
+        // targets are 0 or 1 mod 4, so at most the last pass is a single sample.
+        std::vector<Vector3> sum((size_t)width * height, Vector3(0, 0, 0));
+        std::vector<Vector3> radiance(sum.size());
+        Image img(width, height);
+        int samples = 0;
+        for (int pass = 1; !restarted && target > 1 && samples < target; ++pass) {
+            int count = std::min(PASS_SPP, target - samples);
+            RenderConfig passConfig = config;
+            passConfig.samplesPerPixel = count;
+            passConfig.seed = config.seed + pass;
+            Raytracer tracer(&cam, &scene, accel, passConfig);
+
+            if (!renderFrame(pool, tracer, img, radiance, cameraEdited)) {
+                restarted = true;
+                break;
+            }
+            samples += count;
+            float scale = 1.0f / samples;
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    size_t i = (size_t)y * width + x;
+                    sum[i] = sum[i] + radiance[i] * (float)count;
+                    img.setPixel(x, y, tracer.toPixel(sum[i] * scale));
+                }
+            }
+            publish(img, config.outputImage);
+            std::cout << "  " << width << "x" << height << " " << samples << " spp at " << since(start) * 1000.0 << " ms\n";
+        }
+
+        if (restarted) {
+            std::cout << "Camera changed, restarting\n";
+            continue;
+        }
+
+        // Refined, wait for the next camera edit
+        std::cout << "Done, watching " << config.inputScene << " for camera edits (Ctrl-C to stop)\n";
+        while (!cameraEdited()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        std::cout << "Camera changed, restarting\n";
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "config.h"
+
+// --preview: renders at 1/16 and 1/4 of the pixels, then full resolution,
+// then adds samples up to -spp, rewriting the output after each step.
+// Camera edits in the scene file restart the refinement, the geometry stays
+// loaded. Runs until interrupted, returns the exit code on errors.
+int runPreview(const RenderConfig& config);
+
+#endif
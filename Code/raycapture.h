@@ -0,0 +1,97 @@
+#ifndef RAYCAPTURE_H
+#define RAYCAPTURE_H
+
+#include "maths.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+
+// Rays recorded during a render (--capture-rays) for Bench/replay
+// File: "RAYC", version, count, then count CapturedRay records (little-endian)
+
+enum RayType : uint8_t {
+    RAY_PRIMARY,
+    RAY_SHADOW,
+    RAY_REFLECTION,     // mirror and total internal reflection
+    RAY_REFRACTION,
+    RAY_GLOSSY,
+    RAY_TYPES
+};
+
+struct CapturedRay {
+    float origin[3];
+    float direction[3];
+    float time;
+    float tMax;             // light distance for shadow rays, else infinity
+    float tHit;             // closest hit the renderer found, infinity for a miss
+    uint8_t type;
+    uint8_t depth;
+    uint8_t pad[2];
+
+    Ray ray() const {
+        return Ray(Vector3(origin[0], origin[1], origin[2]),
+                   Vector3(direction[0], direction[1], direction[2]), time);
+    }
+};
+static_assert(sizeof(CapturedRay) == 40, "CapturedRay is written to disk as is");
+
+namespace RayCapture {
+
+const uint32_t VERSION = 1;
+
+inline const char* typeName(int type) {
+    static const char* names[RAY_TYPES] = { "primary", "shadow", "reflection", "refraction", "glossy" };
+    return names[type];
+}
+
+inline CapturedRay make(const Ray& ray, RayType type, int depth, float tMax, float tHit) {
+    CapturedRay c;
+    c.origin[0] = ray.origin.x;
+    c.origin[1] = ray.origin.y;
+    c.origin[2] = ray.origin.z;
+    c.direction[0] = ray.direction.x;
+    c.direction[1] = ray.direction.y;
+    c.direction[2] = ray.direction.z;
+    c.time = ray.time;
+    c.tMax = tMax;
+    c.tHit = tHit;
+    c.type = type;
+    c.depth = static_cast<uint8_t>(depth < 255 ? depth : 255);
+    c.pad[0] = c.pad[1] = 0;
+    return c;
+}
+
+inline bool write(const std::string& path, const std::vector<CapturedRay>& rays) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+
+    uint64_t count = rays.size();
+    out.write("RAYC", 4);
+    out.write(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(rays.data()), count * sizeof(CapturedRay));
+    return (bool)out;
+}
+
+inline bool read(const std::string& path, std::vector<CapturedRay>& rays) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t count = 0;
+    in.read(magic, 4);
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || std::memcmp(magic, "RAYC", 4) != 0 || version != VERSION) return false;
+
+    rays.resize(count);
+    in.read(reinterpret_cast<char*>(rays.data()), count * sizeof(CapturedRay));
+    return (bool)in;
+}
+
+} // namespace RayCapture
+
+#endif
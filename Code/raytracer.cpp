@@ -2,15 +2,60 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <random>
+#include <array>
+#include <utility>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "raytracer.h"
 #include "maths.h"
+#include "trace.h"
+#include "raycapture.h"
+#include "gbuffer.h"
 
 const float SHADOW_BIAS = 0.001;
 const float REFLECTION_BIAS = 0.001;
 const Vector3 BACKGROUND_COLOR(0.3f, 0.3f, 0.3f);
 
+// Rays traced by this thread, only counted by TRACE_RECORD kernels
+static thread_local uint64_t tracedRays = 0;
+
+// Capture target while render() records rays, and the type of the next
+// traced ray (set by shade before spawning, reset to primary once read)
+static thread_local std::vector<CapturedRay>* captured = nullptr;
+static thread_local RayType nextRayType = RAY_PRIMARY;
+
+static inline void recordRay(const Ray& ray, RayType type, int depth, float tMax, float tHit) {
+    tracedRays++;
+    if (captured) captured->push_back(RayCapture::make(ray, type, depth, tMax, tHit));
+}
+
+// Object indices while rendering through a G-buffer, and the touched mask
+// of the pixel being rendered (null outside G-buffer renders)
+static thread_local const std::unordered_map<const Shape*, int>* objectIds = nullptr;
+static thread_local uint64_t* touchedMask = nullptr;
+
+static inline void touch(const Shape* shape) {
+    if (!touchedMask) return;
+    auto it = objectIds->find(shape);
+    if (it != objectIds->end()) *touchedMask |= 1ull << (it->second & 63);
+}
+
+// Cycle counter for the time heatmap, nanoseconds where there is no TSC
+static inline uint64_t cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
 // Sample a random point on light source
 Vector3 samplePointOnLight(const Light& light, const Vector3& target, int gridX, int gridY, int gridSize) {
     if (light.radius <= 0.0f) return light.position;
@@ -89,36 +134,50 @@ Vector3 acesToneMapping(const Vector3& x) {
     );
 }
 
-Vector3 Raytracer::traceRay(const Ray& ray, int depth) const {
+template <unsigned K>
+Vector3 Raytracer::traceKernel(const Ray& ray, int depth) const {
     HitInfo hit;
     hit.hit = false;
 
+    RayType type = RAY_PRIMARY;
+    if constexpr ((K & TRACE_RECORD) != 0) {
+        type = nextRayType;
+        nextRayType = RAY_PRIMARY;
+    }
+
     // Intersection test
-    if (config.useBVH && bvhRoot)
-        bvhRoot->intersect(ray, hit);
+    if constexpr ((K & TRACE_ACCEL) != 0)
+        accel->intersect(ray, hit);
     else
         for (auto* s : scene->shapes)
             s->intersect(ray, hit);
 
+    if constexpr ((K & TRACE_RECORD) != 0) recordRay(ray, type, depth, INFINITY, hit.t);
+
     // If no hit, return background colour
     if (!hit.hit)
         return BACKGROUND_COLOR;
 
+    if constexpr ((K & TRACE_RECORD) != 0) touch(hit.shape);
+
     // Shade
-    return shade(ray, hit, depth);
+    return shadeKernel<K>(ray, hit, depth);
 }
 
 // Compute percentage of light visible
+template <unsigned K>
 Vector3 computeShadowFactor(
     const Scene* scene,
-    const BVHNode* bvh,
+    const Shape* accel,
     const Vector3& origin,
     const Vector3& normal,
     const Light& light,
+    float time,
+    int depth,
     const RenderConfig& config
 ) {
     // Determine sampling quality
-    bool hardShadows = (config.shadowSamples <= 1 || light.radius <= 0.0f);
+    bool hardShadows = ((K & TRACE_SOFT) == 0 || light.radius <= 0.0f);
     int gridSize = static_cast<int>(std::sqrt(config.shadowSamples));
     if (gridSize < 1) gridSize = 1;
     
@@ -144,7 +203,7 @@ Vector3 computeShadowFactor(
 
             Vector3 n = normal;
             n.normalize();
-            Ray shadowRay(origin + n * SHADOW_BIAS, L);
+            Ray shadowRay(origin + n * SHADOW_BIAS, L, time);
 
             Vector3 rayThroughput(1.0f, 1.0f, 1.0f);
             bool blocked = false;
@@ -153,10 +212,13 @@ Vector3 computeShadowFactor(
             int maxPassthrough = 10; 
             while (maxPassthrough-- > 0) {
                 HitInfo h;
-                if (bvh) bvh->intersect(shadowRay, h);
+                RT_STAT(STAT_SHADOW_RAYS);
+                if constexpr ((K & TRACE_ACCEL) != 0) accel->intersect(shadowRay, h);
                 else for (auto* s : scene->shapes) s->intersect(shadowRay, h);
+                if constexpr ((K & TRACE_RECORD) != 0) recordRay(shadowRay, RAY_SHADOW, depth, dist, h.t);
 
                 if (!h.hit || h.t > dist) break;
+                if constexpr ((K & TRACE_RECORD) != 0) touch(h.shape);
                 
                 // If hit glass
                 if (h.shape->material.transparency > 0.0f) {
@@ -190,7 +252,8 @@ Vector3 computeShadowFactor(
 }
 
 
-Vector3 Raytracer::shade(const Ray& ray, const HitInfo& hit, int depth) const {
+template <unsigned K>
+Vector3 Raytracer::shadeKernel(const Ray& ray, const HitInfo& hit, int depth) const {
 
     const Material& mat = hit.shape->material;
     
@@ -226,7 +289,7 @@ Vector3 Raytracer::shade(const Ray& ray, const HitInfo& hit, int depth) const {
         diffuseColor = diffuseColor * textureColour; 
     }
 
-    if (config.noShading) {
+    if constexpr ((K & TRACE_SHADING) == 0) {
         return diffuseColor;
     }
     
@@ -243,10 +306,11 @@ Vector3 Raytracer::shade(const Ray& ray, const HitInfo& hit, int depth) const {
     for (const auto& light : scene->lights) {
 
         // Calculate shadows
-        Vector3 shadowColor = computeShadowFactor(scene, bvhRoot, hit.point, N, light, config);
+        Vector3 shadowColor = computeShadowFactor<K>(scene, accel, hit.point, N, light, ray.time, depth, config);
 
         // If completely in shadow, skip
         if (shadowColor.x <= 0.001f && shadowColor.y <= 0.001f && shadowColor.z <= 0.001f) {
+                RT_STAT(STAT_SHADOW_EARLY_OUTS);
                 continue;
             }
 
@@ -294,16 +358,20 @@ Vector3 Raytracer::shade(const Ray& ray, const HitInfo& hit, int depth) const {
             Vector3 R = ray.direction - normal * (2.0f * ray.direction.dot(normal));
             R.normalize();
             
-            Ray internalRay(hit.point + normal * REFLECTION_BIAS, R); 
-            transmissionColor = traceRay(internalRay, depth + 1);
+            Ray internalRay(hit.point + normal * REFLECTION_BIAS, R, ray.time); 
+            RT_STAT(STAT_REFLECTION_RAYS);
+            if constexpr ((K & TRACE_RECORD) != 0) nextRayType = RAY_REFLECTION;
+            transmissionColor = traceKernel<K>(internalRay, depth + 1);
         } 
         else {
             // Total Internal Reflection
             Vector3 refractDir = ray.direction * eta + normal * (eta * cosi - sqrtf(k));
             refractDir.normalize();
 
-            Ray refractedRay(hit.point + refractDir * REFLECTION_BIAS, refractDir);
-            transmissionColor = traceRay(refractedRay, depth + 1);
+            Ray refractedRay(hit.point + refractDir * REFLECTION_BIAS, refractDir, ray.time);
+            RT_STAT(STAT_REFRACTION_RAYS);
+            if constexpr ((K & TRACE_RECORD) != 0) nextRayType = RAY_REFRACTION;
+            transmissionColor = traceKernel<K>(refractedRay, depth + 1);
         }
 
         finalColour = (finalColour * (1.0f - mat.transparency)) + (transmissionColor * mat.transparency);
@@ -316,10 +384,12 @@ Vector3 Raytracer::shade(const Ray& ray, const HitInfo& hit, int depth) const {
         R.normalize();
 
         // Check if Glossy or Perfect Mirror
-        if (mat.roughness <= 0.001f || config.glossySamples <= 1) {
+        if ((K & TRACE_GLOSSY) == 0 || mat.roughness <= 0.001f) {
 
-            Ray reflectedRay(hit.point + N * REFLECTION_BIAS, R);
-            Vector3 reflectedColor = traceRay(reflectedRay, depth + 1);
+            Ray reflectedRay(hit.point + N * REFLECTION_BIAS, R, ray.time);
+            RT_STAT(STAT_REFLECTION_RAYS);
+            if constexpr ((K & TRACE_RECORD) != 0) nextRayType = RAY_REFLECTION;
+            Vector3 reflectedColor = traceKernel<K>(reflectedRay, depth + 1);
             finalColour = (finalColour * (1.0f - mat.reflectivity)) + (reflectedColor * mat.reflectivity);
         }
         else {
@@ -346,8 +416,10 @@ Vector3 Raytracer::shade(const Ray& ray, const HitInfo& hit, int depth) const {
                        continue;
                     }
 
-                    Ray glossyRay(hit.point + N * REFLECTION_BIAS, glossyDir);
-                    accumulatedReflection = accumulatedReflection + traceRay(glossyRay, depth + 1);
+                    Ray glossyRay(hit.point + N * REFLECTION_BIAS, glossyDir, ray.time);
+                    RT_STAT(STAT_GLOSSY_RAYS);
+                    if constexpr ((K & TRACE_RECORD) != 0) nextRayType = RAY_GLOSSY;
+                    accumulatedReflection = accumulatedReflection + traceKernel<K>(glossyRay, depth + 1);
                     validSamples += 1.0f;
                 }
             }
@@ -363,10 +435,39 @@ Vector3 Raytracer::shade(const Ray& ray, const HitInfo& hit, int depth) const {
 }
 
 // Render loop
-void Raytracer::render(Image& img) const {
+// Exposure, tone mapping, gamma and quantisation of a linear pixel colour
+template <ToneMappingMode toneMapping>
+static Pixel displayPixel(Vector3 pixelColour, float exposure) {
+    pixelColour = pixelColour * exposure;
+
+    // Tone mapping 
+    if constexpr (toneMapping == ToneMappingMode::Reinhard) {
+        pixelColour = reinhardToneMapping(pixelColour);
+    } else if constexpr (toneMapping == ToneMappingMode::ACES) {
+        pixelColour = acesToneMapping(pixelColour);
+    } 
+
+    // Gamma Correction
+    float invGamma = 1.0f / 2.2f;
+    pixelColour.x = powf(pixelColour.x, invGamma);
+    pixelColour.y = powf(pixelColour.y, invGamma);
+    pixelColour.z = powf(pixelColour.z, invGamma);
+
+    return Pixel(
+        static_cast<unsigned char>(std::clamp(pixelColour.x * 255.0f, 0.0f, 255.0f)),
+        static_cast<unsigned char>(std::clamp(pixelColour.y * 255.0f, 0.0f, 255.0f)),
+        static_cast<unsigned char>(std::clamp(pixelColour.z * 255.0f, 0.0f, 255.0f))
+    );
+}
+
+template <unsigned K>
+void Raytracer::renderKernel(Image& img, const Tile& tile, const RenderBuffers& out) const {
+
+    constexpr bool lens   = (K & RENDER_LENS) != 0;
+    constexpr bool motion = (K & RENDER_MOTION) != 0;
+    constexpr auto toneMapping = static_cast<ToneMappingMode>(K >> RENDER_TM_SHIFT);
 
     int width  = img.getWidth();  
-    int height = img.getHeight();
 
     int spp = config.samplesPerPixel;
     int gridSide = static_cast<int>(std::sqrt(spp));
@@ -374,34 +475,58 @@ void Raytracer::render(Image& img) const {
 
     float subStep = 1.0f / gridSide;
 
-    for (int y = 0; y < height; ++y) {
+    bool timeHeat = (config.heatmap == HeatmapMode::Time);
+
+    for (int y = tile.y0; y < tile.y1; ++y) {
+        TRACE_SCOPE("row", y);
 
         // Progress bar
-        float progress = (float)(y+1)  / (float)height;
-        
-        int barWidth = 60; 
-
-        std::cout << "[";
-        int pos = barWidth * progress;
-        for (int i = 0; i < barWidth; ++i) {
-            if (i < pos) std::cout << "=";
-            else if (i == pos) std::cout << ">";
-            else std::cout << " ";
-        }
+        if (out.progress) {
+            float progress = (float)(y - tile.y0 + 1) / (float)(tile.y1 - tile.y0);
 
-        std::cout << "] " << int(progress * 100.0) << " %\r" << std::flush;
+            int barWidth = 60; 
 
-        for (int x = 0; x < width; ++x) {
+            std::cout << "[";
+            int pos = barWidth * progress;
+            for (int i = 0; i < barWidth; ++i) {
+                if (i < pos) std::cout << "=";
+                else if (i == pos) std::cout << ">";
+                else std::cout << " ";
+            }
+
+            std::cout << "] " << int(progress * 100.0) << " %\r" << std::flush;
+        }
+
+        for (int x = tile.x0; x < tile.x1; ++x) {
 
             Vector3 pixelColour(0, 0, 0);
+            size_t pixel = (size_t)y * width + x;
+
+            uint64_t pixelStart = 0;
+            if (out.heat) pixelStart = timeHeat ? cycleCount() : tracedRays;
+
+            // Unaffected by the changes since the G-buffer was written
+            bool keep = out.reshade && !out.reshade[pixel];
+            if (out.touched && !keep) {
+                out.touched[pixel] = 0;
+                touchedMask = &out.touched[pixel];
+            }
             
             // Anti-Aliasing Loop
-            for (int sy = 0; sy < gridSide; ++sy) {
+            for (int sy = 0; sy < gridSide && !keep; ++sy) {
                 for (int sx = 0; sx < gridSide; ++sx) {
                     
                     float u, v;
+                    GSample* sample = out.hits ? &out.hits[pixel * gridSide * gridSide + sy * gridSide + sx] : nullptr;
+                    if (sample && out.reuseHits) {
+                        seedRandom(sample->seed);
+                    } else {
+                        uint64_t seed = sampleSeed(config.seed, x, y, sy * gridSide + sx);
+                        if (sample) sample->seed = seed;
+                        seedRandom(seed);
+                    }
 
-                    if (spp == 1) {
+                    if constexpr ((K & RENDER_JITTER) == 0) {
                         // Centre pixel
                         u = x + 0.5f;
                         v = y + 0.5f;
@@ -413,35 +538,236 @@ void Raytracer::render(Image& img) const {
                         v = y + (sy * subStep) + (r2 * subStep);
                     }
 
-                    Ray ray = camera->pixelToRay(u, v, sx, sy, gridSide);
-                    pixelColour = pixelColour + traceRay(ray, 0);
+                    Ray ray = camera->pixelToRay<lens, motion>(u, v, sx, sy, gridSide);
+                    RT_STAT(STAT_PRIMARY_RAYS);
+                    if (sample) pixelColour = pixelColour + tracePrimary(ray, *sample, out.reuseHits);
+                    else pixelColour = pixelColour + (this->*traceFn)(ray, 0);
                 }
             }
+            touchedMask = nullptr;
             
-            pixelColour = pixelColour / static_cast<float>(gridSide * gridSide);
+            if (out.heat) {
+                uint64_t pixelEnd = timeHeat ? cycleCount() : tracedRays;
+                out.heat[pixel] = static_cast<float>(pixelEnd - pixelStart);
+            }
 
-            pixelColour = pixelColour * config.exposure;
+            if (keep) pixelColour = out.radiance[pixel];
+            else pixelColour = pixelColour / static_cast<float>(gridSide * gridSide);
+            if (out.radiance) out.radiance[pixel] = pixelColour;
 
-            // Tone mapping 
-            if (config.toneMapping == ToneMappingMode::Reinhard) {
-                pixelColour = reinhardToneMapping(pixelColour);
-            } else if (config.toneMapping == ToneMappingMode::ACES) {
-                pixelColour = acesToneMapping(pixelColour);
-            } 
+            img.setPixel(x, y, displayPixel<toneMapping>(pixelColour, config.exposure));
+        }
+    }
 
-            // Gamma Correction
-            float invGamma = 1.0f / 2.2f;
-            pixelColour.x = powf(pixelColour.x, invGamma);
-            pixelColour.y = powf(pixelColour.y, invGamma);
-            pixelColour.z = powf(pixelColour.z, invGamma);
-            
-           
-            img.setPixel(x, y, Pixel(
-                static_cast<unsigned char>(std::clamp(pixelColour.x * 255.0f, 0.0f, 255.0f)),
-                static_cast<unsigned char>(std::clamp(pixelColour.y * 255.0f, 0.0f, 255.0f)),
-                static_cast<unsigned char>(std::clamp(pixelColour.z * 255.0f, 0.0f, 255.0f))
-            ));
+}
+
+// Kernel selection
+template <std::size_t... K>
+std::array<Raytracer::TraceFn, sizeof...(K)> Raytracer::traceTable(std::index_sequence<K...>) {
+    return {{ &Raytracer::traceKernel<K>... }};
+}
+
+template <std::size_t... K>
+std::array<Raytracer::ShadeFn, sizeof...(K)> Raytracer::shadeTable(std::index_sequence<K...>) {
+    return {{ &Raytracer::shadeKernel<K>... }};
+}
+
+template <std::size_t... K>
+std::array<Raytracer::RenderFn, sizeof...(K)> Raytracer::renderTable(std::index_sequence<K...>) {
+    return {{ &Raytracer::renderKernel<K>... }};
+}
+
+unsigned Raytracer::traceFlags() const {
+    unsigned k = 0;
+    if (config.useBVH && accel)     k |= TRACE_ACCEL;
+    if (!config.noShading)          k |= TRACE_SHADING;
+    if (config.glossySamples > 1)   k |= TRACE_GLOSSY;
+    if (config.shadowSamples > 1)   k |= TRACE_SOFT;
+    if (config.heatmap == HeatmapMode::Rays || !config.captureFile.empty() || !config.gbufferFile.empty()) k |= TRACE_RECORD;
+    return k;
+}
+
+unsigned Raytracer::renderFlags() const {
+    unsigned k = static_cast<unsigned>(config.toneMapping) << RENDER_TM_SHIFT;
+    if (camera->hasLens())           k |= RENDER_LENS;
+    if (camera->hasMotion() || scene->hasMotion) k |= RENDER_MOTION;
+    if (config.samplesPerPixel != 1) k |= RENDER_JITTER;
+    return k;
+}
+
+Raytracer::Raytracer(const Camera* cam, const Scene* scn, const Shape* acc, const RenderConfig& cfg)
+    : camera(cam), scene(scn), accel(acc), config(cfg)
+{
+    static const auto traceKernels  = traceTable(std::make_index_sequence<TRACE_KERNELS>());
+    static const auto shadeKernels  = shadeTable(std::make_index_sequence<TRACE_KERNELS>());
+    static const auto renderKernels = renderTable(std::make_index_sequence<RENDER_KERNELS>());
+
+    traceFn  = traceKernels[traceFlags()];
+    shadeFn  = shadeKernels[traceFlags()];
+    renderFn = renderKernels[renderFlags()];
+}
+
+Vector3 Raytracer::traceRay(const Ray& ray, int depth) const {
+    return (this->*traceFn)(ray, depth);
+}
+
+Vector3 Raytracer::shade(const Ray& ray, const HitInfo& hit, int depth) const {
+    return (this->*shadeFn)(ray, hit, depth);
+}
+
+void Raytracer::render(Image& img) const {
+    renderFrame(img, Tile{ 0, 0, img.getWidth(), img.getHeight() }, nullptr);
+}
+
+void Raytracer::render(Image& img, std::vector<Vector3>& radiance) const {
+    radiance.assign((size_t)img.getWidth() * img.getHeight(), Vector3(0, 0, 0));
+    renderFrame(img, Tile{ 0, 0, img.getWidth(), img.getHeight() }, radiance.data());
+}
+
+void Raytracer::render(Image& img, const Tile& window) const {
+    renderFrame(img, window, nullptr);
+}
+
+void Raytracer::renderTile(Image& img, const Tile& tile, Vector3* radiance) const {
+    RenderBuffers out;
+    out.radiance = radiance;
+    (this->*renderFn)(img, tile, out);
+}
+
+void Raytracer::render(Image& img, GBuffer& gbuffer, const unsigned char* reshade, bool reuse) const {
+    TRACE_SCOPE("render");
+
+    std::unordered_map<const Shape*, int> ids;
+    for (size_t i = 0; i < scene->objects.size(); ++i) ids[scene->objects[i]] = (int)i;
+    objectIds = &ids;
+
+    RenderBuffers out;
+    out.radiance = gbuffer.radiance.data();
+    out.progress = true;
+    out.hits = gbuffer.hits.data();
+    out.reuseHits = reuse;
+    out.touched = gbuffer.touched.data();
+    out.reshade = reshade;
+    (this->*renderFn)(img, Tile{ 0, 0, img.getWidth(), img.getHeight() }, out);
+    objectIds = nullptr;
+}
+
+Vector3 Raytracer::tracePrimary(const Ray& ray, GSample& sample, bool reuse) const {
+    HitInfo hit;
+    if (reuse) {
+        if (sample.object >= 0) {
+            hit.hit = true;
+            hit.t = sample.t;
+            hit.point = sample.point;
+            hit.normal = sample.normal;
+            hit.u = sample.u;
+            hit.v = sample.v;
+            hit.shape = scene->objects[sample.object];
         }
+    } else {
+        if (config.useBVH && accel) accel->intersect(ray, hit);
+        else for (auto* s : scene->shapes) s->intersect(ray, hit);
+
+        auto id = hit.hit ? objectIds->find(hit.shape) : objectIds->end();
+        sample.object = (id != objectIds->end()) ? id->second : -1;
+        sample.t = hit.t;
+        sample.point = hit.point;
+        sample.normal = hit.normal;
+        sample.u = hit.u;
+        sample.v = hit.v;
+    }
+    recordRay(ray, RAY_PRIMARY, 0, INFINITY, hit.t);
+
+    if (!hit.hit) return BACKGROUND_COLOR;
+    touch(hit.shape);
+    return (this->*shadeFn)(ray, hit, 0);
+}
+
+Pixel Raytracer::toPixel(const Vector3& radiance) const {
+    switch (config.toneMapping) {
+        case ToneMappingMode::Reinhard: return displayPixel<ToneMappingMode::Reinhard>(radiance, config.exposure);
+        case ToneMappingMode::ACES:     return displayPixel<ToneMappingMode::ACES>(radiance, config.exposure);
+        default:                        return displayPixel<ToneMappingMode::None>(radiance, config.exposure);
     }
+}
 
-}
\ No newline at end of file
+void Raytracer::renderFrame(Image& img, const Tile& window, Vector3* radiance) const {
+    TRACE_SCOPE("render");
+
+    std::vector<float> heat;
+    if (config.heatmap != HeatmapMode::Off) heat.assign((size_t)img.getWidth() * img.getHeight(), 0.0f);
+
+    std::vector<CapturedRay> rays;
+    if (!config.captureFile.empty()) captured = &rays;
+
+    RenderBuffers out;
+    out.heat = heat.empty() ? nullptr : heat.data();
+    out.radiance = radiance;
+    out.progress = true;
+    (this->*renderFn)(img, window, out);
+    captured = nullptr;
+
+    if (!heat.empty()) writeHeatmap(heat, img.getWidth(), img.getHeight());
+
+    if (!config.captureFile.empty()) {
+        TRACE_SCOPE("writeCapture");
+        if (RayCapture::write(config.captureFile, rays)) {
+            std::cout << "\nCaptured " << rays.size() << " rays to " << config.captureFile << " ("
+                      << rays.size() * sizeof(CapturedRay) / (1024.0 * 1024.0) << " MB)\n";
+        } else {
+            std::cerr << "\nFailed to write rays to " << config.captureFile << "\n";
+        }
+    }
+}
+
+// Black, blue, magenta, orange, yellow, white
+static Pixel heatColour(float v) {
+    static const float stops[6][3] = {
+        { 0.0f, 0.0f, 0.0f }, { 0.1f, 0.1f, 0.6f }, { 0.7f, 0.1f, 0.6f },
+        { 1.0f, 0.5f, 0.1f }, { 1.0f, 0.9f, 0.2f }, { 1.0f, 1.0f, 1.0f }
+    };
+
+    float f = std::clamp(v, 0.0f, 1.0f) * 5.0f;
+    int i = std::min(4, static_cast<int>(f));
+    float t = f - i;
+
+    unsigned char c[3];
+    for (int k = 0; k < 3; ++k) {
+        c[k] = static_cast<unsigned char>(255.0f * (stops[i][k] + (stops[i + 1][k] - stops[i][k]) * t));
+    }
+    return Pixel(c[0], c[1], c[2]);
+}
+
+void Raytracer::writeHeatmap(const std::vector<float>& heat, int width, int height) const {
+    TRACE_SCOPE("writeHeatmap");
+
+    // Log scale so 100x hotspots and cheap pixels both stay readable
+    float maxValue = 0.0f;
+    double total = 0.0;
+    for (float v : heat) {
+        maxValue = std::max(maxValue, v);
+        total += v;
+    }
+    float logMax = std::log1p(maxValue);
+
+    Image map(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float v = heat[y * width + x];
+            map.setPixel(x, y, heatColour(logMax > 0.0f ? std::log1p(v) / logMax : 0.0f));
+        }
+    }
+
+    // foo.ppm -> foo_heat.ppm and foo_heat.pfm
+    std::string base = config.outputImage;
+    size_t dot = base.find_last_of('.');
+    size_t slash = base.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) base = base.substr(0, dot);
+
+    const char* unit = (config.heatmap == HeatmapMode::Time) ? "cycles" : "rays";
+    std::cout << "\nHeatmap: mean " << total / heat.size() << " " << unit << " per pixel, max " << maxValue << "\n";
+    map.writePPM(base + "_heat.ppm");
+    if (writePFM(base + "_heat.pfm", heat, width, height)) {
+        std::cout << "Raw values written to " << base + "_heat.pfm" << "\n";
+    }
+}
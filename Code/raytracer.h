@@ -6,10 +6,56 @@
 #include "image.h"
 #include "config.h"
 
+#include <array>
+#include <utility>
+
+struct GSample;
+struct GBuffer;
+
+// Tone mapping operators, applied per pixel after exposure
+Vector3 reinhardToneMapping(const Vector3& x);
+Vector3 acesToneMapping(const Vector3& x);
+
+// Trace kernel flags
+enum TraceFlags : unsigned {
+    TRACE_ACCEL   = 1u << 0,  // intersect through the acceleration structure
+    TRACE_SHADING = 1u << 1,  // lighting enabled (not -no-shading)
+    TRACE_GLOSSY  = 1u << 2,  // glossySamples > 1
+    TRACE_SOFT    = 1u << 3,  // shadowSamples > 1
+    TRACE_RECORD  = 1u << 4,  // count rays (heatmap) and capture them (--capture-rays)
+    TRACE_KERNELS = 1u << 5
+};
+
+// Render kernel flags
+enum RenderFlags : unsigned {
+    RENDER_LENS     = 1u << 0,  // aperture > 0
+    RENDER_MOTION   = 1u << 1,  // camera velocity != 0 or moving shapes
+    RENDER_JITTER   = 1u << 2,  // spp > 1
+    RENDER_TM_SHIFT = 3,        // 2 bits of ToneMappingMode
+    RENDER_KERNELS  = 1u << 5
+};
+
+// Optional per-pixel outputs of the render kernels, null when unused
+struct RenderBuffers {
+    float* heat = nullptr;          // -heatmap cost
+    Vector3* radiance = nullptr;    // linear colour before exposure and tone mapping
+    bool progress = false;          // draw the progress bar
+
+    // --gbuffer, see gbuffer.h
+    GSample* hits = nullptr;        // primary hit per sample, written or (reuseHits) read
+    bool reuseHits = false;
+    uint64_t* touched = nullptr;    // objects each pixel's rays hit
+    const unsigned char* reshade = nullptr;  // 0 keeps the pixel's radiance as it is
+};
+
+// Pixel rectangle [x0, x1) x [y0, y1) of the frame
+struct Tile {
+    int x0, y0, x1, y1;
+};
+
 class Raytracer {
 public:
-    Raytracer(const Camera* cam, const Scene* scn, const BVHNode* bvh, const RenderConfig& cfg)
-        : camera(cam), scene(scn), bvhRoot(bvh), config(cfg) {}
+    Raytracer(const Camera* cam, const Scene* scn, const Shape* accel, const RenderConfig& cfg);
 
     // Main recursive function
     Vector3 traceRay(const Ray& ray, int depth) const;
@@ -19,11 +65,57 @@ public:
     
     void render(Image& img) const;
 
+    // Also returns the linear pixel colours, row-major
+    void render(Image& img, std::vector<Vector3>& radiance) const;
+
+    // Only the window (-crop), rays as in the full frame, the rest of img is left alone
+    void render(Image& img, const Tile& window) const;
+
+    // Only the pixels of tile, the rest of img is left alone. Samples are
+    // seeded by pixel, so tiles match the full render and disjoint tiles can
+    // be rendered from several threads at once. radiance is frame-sized.
+    void renderTile(Image& img, const Tile& tile, Vector3* radiance = nullptr) const;
+
+    // Records gbuffer's hits, radiance and touched objects, or with reuse
+    // shades from its hits; pixels with reshade[i] == 0 keep their radiance
+    void render(Image& img, GBuffer& gbuffer, const unsigned char* reshade, bool reuse) const;
+
+    // Display colour of a radiance value as the render kernels write it
+    Pixel toPixel(const Vector3& radiance) const;
+
 private:
     const Camera* camera;
     const Scene* scene;
-    const BVHNode* bvhRoot;
+    const Shape* accel;         // BVH or grid over scene->shapes
     RenderConfig config;
+
+    // Kernels specialised on the flags above, selected once at construction
+    using TraceFn  = Vector3 (Raytracer::*)(const Ray&, int) const;
+    using ShadeFn  = Vector3 (Raytracer::*)(const Ray&, const HitInfo&, int) const;
+    using RenderFn = void (Raytracer::*)(Image&, const Tile&, const RenderBuffers&) const;
+
+    TraceFn traceFn;
+    ShadeFn shadeFn;
+    RenderFn renderFn;
+
+    template <unsigned K> Vector3 traceKernel(const Ray& ray, int depth) const;
+    template <unsigned K> Vector3 shadeKernel(const Ray& ray, const HitInfo& hit, int depth) const;
+    template <unsigned K> void renderKernel(Image& img, const Tile& tile, const RenderBuffers& out) const;
+
+    template <std::size_t... K> static std::array<TraceFn, sizeof...(K)> traceTable(std::index_sequence<K...>);
+    template <std::size_t... K> static std::array<ShadeFn, sizeof...(K)> shadeTable(std::index_sequence<K...>);
+    template <std::size_t... K> static std::array<RenderFn, sizeof...(K)> renderTable(std::index_sequence<K...>);
+
+    // Primary ray whose hit goes through the G-buffer
+    Vector3 tracePrimary(const Ray& ray, GSample& sample, bool reuse) const;
+
+    unsigned traceFlags() const;
+    unsigned renderFlags() const;
+
+    void renderFrame(Image& img, const Tile& window, Vector3* radiance) const;
+
+    // False-colour PPM and raw PFM beside the output image
+    void writeHeatmap(const std::vector<float>& heat, int width, int height) const;
 };
 
-#endif
\ No newline at end of file
+#endif
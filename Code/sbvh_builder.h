@@ -0,0 +1,390 @@
+#ifndef SBVH_BUILDER_H
+#define SBVH_BUILDER_H
+
+#include "BVH.h"
+#include "trace.h"
+#include "shapes/triangle.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Spatial-split BVH builder (Stich, Friedrich & Dietrich, "Spatial Splits
+// in Bounding Volume Hierarchies"). Next to binned object splits it tries
+// cutting the node into slabs, clipping triangles to each side, so a long
+// thin triangle can sit in several leaves with tight boxes. Other shapes
+// are split by their bounding box. Extra references are capped at
+// dupBudget times the primitive count.
+class SBVHBuilder {
+public:
+    explicit SBVHBuilder(float dupBudget = 0.3f) : budget(dupBudget) {}
+
+    BVHNode* build(const std::vector<Shape*>& shapes) {
+        TRACE_SCOPE("SBVH build", (int)shapes.size());
+        if (shapes.empty()) return nullptr;
+
+        std::vector<Ref> refs(shapes.size());
+        AABB box;
+        for (size_t i = 0; i < shapes.size(); ++i) {
+            refs[i].shape = shapes[i];
+            refs[i].tri = dynamic_cast<const Triangle*>(shapes[i]);
+            refs[i].box = shapes[i]->bounds();
+            box.expand(refs[i].box);
+        }
+
+        rootArea = box.surfaceArea();
+        refCount = shapes.size();
+        maxRefs = shapes.size() + static_cast<size_t>(budget * shapes.size());
+
+        NodePool* pool = new NodePool();
+        BVHNode* top = buildNode(refs, box, 0, pool->acquire());
+        return BVHNode::makeRoot(top, pool);
+    }
+
+    // Leaf references after the last build, primitives plus duplicates
+    size_t references() const { return refCount; }
+
+private:
+    struct Ref {
+        AABB box;               // clipped bounds of this piece
+        Shape* shape;
+        const Triangle* tri;    // for exact clipping, null for other shapes
+    };
+
+    struct Bin {
+        AABB box;
+        size_t count = 0;       // object bins: centroids in this bin
+        size_t enter = 0;       // spatial bins: references starting here
+        size_t exit = 0;        // and ending here
+    };
+
+    struct Split {
+        float cost = INFINITY;
+        int axis = -1;
+        float pos = 0.0f;       // object: centroid bin, spatial: plane
+        AABB left, right;
+    };
+
+    static const int BINS = 16;
+    static const int MAX_DEPTH = 64;
+    static constexpr float ALPHA = 1e-5f;   // overlap / root area that makes spatial splits worth trying
+
+    float budget;
+    float rootArea = 0.0f;
+    size_t refCount = 0;
+    size_t maxRefs = 0;
+
+    static float axisOf(const Vector3& v, int axis) {
+        return (axis == 0) ? v.x : (axis == 1) ? v.y : v.z;
+    }
+    static void setAxis(Vector3& v, int axis, float value) {
+        if (axis == 0) v.x = value;
+        else if (axis == 1) v.y = value;
+        else v.z = value;
+    }
+
+    static AABB overlap(const AABB& a, const AABB& b) {
+        AABB o;
+        o.min = Vector3(std::max(a.min.x, b.min.x), std::max(a.min.y, b.min.y), std::max(a.min.z, b.min.z));
+        o.max = Vector3(std::min(a.max.x, b.max.x), std::min(a.max.y, b.max.y), std::min(a.max.z, b.max.z));
+        return o;
+    }
+
+    static bool empty(const AABB& b) {
+        return b.min.x > b.max.x || b.min.y > b.max.y || b.min.z > b.max.z;
+    }
+
+    BVHNode* buildNode(std::vector<Ref>& refs, const AABB& box, int depth, Arena& arena) {
+        size_t count = refs.size();
+        if (count == 1) {
+            return arena.makeTrivial<BVHNode>(refs[0].shape, nullptr, refs[0].box);
+        }
+
+        Split object = findObjectSplit(refs);
+
+        // Spatial splits only pay off where the object split overlaps
+        std::vector<Ref> left, right;
+        bool spatial = false;
+        if (depth < MAX_DEPTH && refCount < maxRefs && object.axis >= 0 &&
+            overlap(object.left, object.right).surfaceArea() > ALPHA * rootArea) {
+
+            Split split = findSpatialSplit(refs, box);
+            if (split.cost < object.cost) {
+                spatial = spatialPartition(refs, split, left, right);
+            }
+        }
+
+        if (!spatial) {
+            objectPartition(refs, object, left, right);
+        }
+
+        // Children own their refs from here on
+        std::vector<Ref>().swap(refs);
+
+        AABB leftBox, rightBox;
+        for (const Ref& r : left) leftBox.expand(r.box);
+        for (const Ref& r : right) rightBox.expand(r.box);
+
+        BVHNode* l = buildNode(left, leftBox, depth + 1, arena);
+        BVHNode* r = buildNode(right, rightBox, depth + 1, arena);
+        return arena.makeTrivial<BVHNode>(l, r, box);
+    }
+
+    // Binned SAH over reference centroids, as in BVHBuilder
+    Split findObjectSplit(const std::vector<Ref>& refs) const {
+        AABB cbox;
+        for (const Ref& r : refs) cbox.expand(r.box.centre());
+
+        Split best;
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = axisOf(cbox.min, axis);
+            float extent = axisOf(cbox.max, axis) - lo;
+            if (extent <= 0.0f) continue;
+
+            Bin bins[BINS];
+            float scale = BINS / extent;
+            for (const Ref& r : refs) {
+                Bin& b = bins[centroidBin(r, axis, lo, scale)];
+                b.box.expand(r.box);
+                b.count++;
+            }
+
+            float cost;
+            int bin = sweep(bins, cost);
+            if (bin >= 0 && cost < best.cost) {
+                best.cost = cost;
+                best.axis = axis;
+                best.pos = static_cast<float>(bin);
+                sweepBoxes(bins, bin, best.left, best.right);
+            }
+        }
+        return best;
+    }
+
+    // Spatial bins over the node box, each reference clipped into every bin it spans
+    Split findSpatialSplit(const std::vector<Ref>& refs, const AABB& box) const {
+        Split best;
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = axisOf(box.min, axis);
+            float extent = axisOf(box.max, axis) - lo;
+            if (extent <= 0.0f) continue;
+
+            Bin bins[BINS];
+            float width = extent / BINS;
+            for (const Ref& r : refs) {
+                int b0 = planeBin(axisOf(r.box.min, axis), lo, width);
+                int b1 = planeBin(axisOf(r.box.max, axis), lo, width);
+                bins[b0].enter++;
+                bins[b1].exit++;
+
+                Ref piece = r;
+                for (int b = b0; b < b1; ++b) {
+                    AABB l, rt;
+                    clip(piece, axis, lo + (b + 1) * width, l, rt);
+                    bins[b].box.expand(l);
+                    piece.box = rt;
+                }
+                bins[b1].box.expand(piece.box);
+            }
+
+            // Left counts are entries, right counts are exits
+            float rightArea[BINS];
+            size_t rightCount[BINS];
+            AABB acc;
+            size_t n = 0;
+            for (int b = BINS - 1; b > 0; --b) {
+                acc.expand(bins[b].box);
+                n += bins[b].exit;
+                rightArea[b] = acc.surfaceArea();
+                rightCount[b] = n;
+            }
+
+            acc = AABB();
+            n = 0;
+            for (int b = 0; b < BINS - 1; ++b) {
+                acc.expand(bins[b].box);
+                n += bins[b].enter;
+                if (n == 0 || rightCount[b + 1] == 0) continue;
+
+                float cost = n * acc.surfaceArea() + rightCount[b + 1] * rightArea[b + 1];
+                if (cost < best.cost) {
+                    best.cost = cost;
+                    best.axis = axis;
+                    best.pos = lo + (b + 1) * width;
+                }
+            }
+        }
+        return best;
+    }
+
+    // Sweep object bins, returns the best bin to split after (or -1)
+    static int sweep(const Bin* bins, float& bestCost) {
+        float rightArea[BINS];
+        size_t rightCount[BINS];
+        AABB acc;
+        size_t n = 0;
+        for (int b = BINS - 1; b > 0; --b) {
+            acc.expand(bins[b].box);
+            n += bins[b].count;
+            rightArea[b] = acc.surfaceArea();
+            rightCount[b] = n;
+        }
+
+        int best = -1;
+        bestCost = INFINITY;
+        acc = AABB();
+        n = 0;
+        for (int b = 0; b < BINS - 1; ++b) {
+            acc.expand(bins[b].box);
+            n += bins[b].count;
+            if (n == 0 || rightCount[b + 1] == 0) continue;
+
+            float cost = n * acc.surfaceArea() + rightCount[b + 1] * rightArea[b + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                best = b;
+            }
+        }
+        return best;
+    }
+
+    static void sweepBoxes(const Bin* bins, int split, AABB& left, AABB& right) {
+        left = AABB();
+        right = AABB();
+        for (int b = 0; b < BINS; ++b) {
+            (b <= split ? left : right).expand(bins[b].box);
+        }
+    }
+
+    void objectPartition(std::vector<Ref>& refs, const Split& split,
+                         std::vector<Ref>& left, std::vector<Ref>& right) const {
+        if (split.axis >= 0) {
+            AABB cbox;
+            for (const Ref& r : refs) cbox.expand(r.box.centre());
+            float lo = axisOf(cbox.min, split.axis);
+            float scale = BINS / (axisOf(cbox.max, split.axis) - lo);
+            int bin = static_cast<int>(split.pos);
+
+            for (const Ref& r : refs) {
+                (centroidBin(r, split.axis, lo, scale) <= bin ? left : right).push_back(r);
+            }
+            if (!left.empty() && !right.empty()) return;
+            left.clear();
+            right.clear();
+        }
+
+        // All centroids in one place: split the list in half
+        size_t mid = refs.size() / 2;
+        left.assign(refs.begin(), refs.begin() + mid);
+        right.assign(refs.begin() + mid, refs.end());
+    }
+
+    // Returns false (leaving left and right empty) if the split makes no progress
+    bool spatialPartition(const std::vector<Ref>& refs, const Split& split,
+                          std::vector<Ref>& left, std::vector<Ref>& right) {
+        int axis = split.axis;
+        float pos = split.pos;
+
+        AABB lb, rb;
+        std::vector<const Ref*> straddling;
+        for (const Ref& r : refs) {
+            if (axisOf(r.box.max, axis) <= pos) {
+                left.push_back(r);
+                lb.expand(r.box);
+            } else if (axisOf(r.box.min, axis) >= pos) {
+                right.push_back(r);
+                rb.expand(r.box);
+            } else {
+                straddling.push_back(&r);
+            }
+        }
+
+        // Split each straddling reference, or keep it whole on one side if cheaper
+        size_t added = 0;
+        for (const Ref* r : straddling) {
+            AABB l, rt;
+            clip(*r, axis, pos, l, rt);
+            float nl = static_cast<float>(left.size());
+            float nr = static_cast<float>(right.size());
+
+            float costLeft = AABB::combine(lb, r->box).surfaceArea() * (nl + 1) + rb.surfaceArea() * nr;
+            float costRight = lb.surfaceArea() * nl + AABB::combine(rb, r->box).surfaceArea() * (nr + 1);
+            float costSplit = INFINITY;
+            if (!empty(l) && !empty(rt) && refCount + added < maxRefs) {
+                costSplit = AABB::combine(lb, l).surfaceArea() * (nl + 1) +
+                            AABB::combine(rb, rt).surfaceArea() * (nr + 1);
+            }
+
+            if (costSplit < costLeft && costSplit < costRight) {
+                Ref a = *r, b = *r;
+                a.box = l;
+                b.box = rt;
+                left.push_back(a);
+                right.push_back(b);
+                lb.expand(l);
+                rb.expand(rt);
+                added++;
+            } else if (costLeft <= costRight) {
+                left.push_back(*r);
+                lb.expand(r->box);
+            } else {
+                right.push_back(*r);
+                rb.expand(r->box);
+            }
+        }
+
+        if (left.empty() || right.empty() || left.size() == refs.size() || right.size() == refs.size()) {
+            left.clear();
+            right.clear();
+            return false;
+        }
+        refCount += added;
+        return true;
+    }
+
+    // Bounds of the parts of a reference on either side of a plane
+    static void clip(const Ref& ref, int axis, float pos, AABB& left, AABB& right) {
+        left = AABB();
+        right = AABB();
+
+        if (ref.tri) {
+            const Vector3* v[3] = { &ref.tri->v0, &ref.tri->v1, &ref.tri->v2 };
+            for (int e = 0; e < 3; ++e) {
+                const Vector3& a = *v[e];
+                const Vector3& b = *v[(e + 1) % 3];
+                float ca = axisOf(a, axis);
+                float cb = axisOf(b, axis);
+
+                if (ca <= pos) left.expand(a);
+                if (ca >= pos) right.expand(a);
+
+                // Edge crosses the plane
+                if ((ca < pos && cb > pos) || (ca > pos && cb < pos)) {
+                    Vector3 p = a + (b - a) * ((pos - ca) / (cb - ca));
+                    setAxis(p, axis, pos);
+                    left.expand(p);
+                    right.expand(p);
+                }
+            }
+        } else {
+            left = ref.box;
+            right = ref.box;
+        }
+
+        // Stay inside the reference's current box and on the right side of the plane
+        setAxis(left.max, axis, std::min(axisOf(left.max, axis), pos));
+        setAxis(right.min, axis, std::max(axisOf(right.min, axis), pos));
+        left = overlap(left, ref.box);
+        right = overlap(right, ref.box);
+    }
+
+    static int centroidBin(const Ref& r, int axis, float lo, float scale) {
+        float v = axisOf(r.box.centre(), axis);
+        return std::clamp(static_cast<int>((v - lo) * scale), 0, BINS - 1);
+    }
+
+    static int planeBin(float v, float lo, float width) {
+        return std::clamp(static_cast<int>((v - lo) / width), 0, BINS - 1);
+    }
+};
+
+#endif
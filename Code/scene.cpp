@@ -2,29 +2,38 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <chrono>
 
 #include "scene.h"
 #include "image.h"    
+#include "trace.h"
+#include "budget.h"
 #include "shapes/sphere.h"
 #include "shapes/cube.h"
 #include "shapes/plane.h"
 #include "shapes/triangle.h"
+#include "shapes/instance.h"
+#include "shapes/sphereset.h"
+#include "shapes/moving.h"
 
 
-// Mesh loader (OBJ) 
-void loadMesh(const std::string& filepath,
-              const Vector3& translation,
-              const Vector3& rotation,
-              float scale,
-              const Material& mat,
-              Scene& scene)
+// Mesh loader (OBJ)
+// Geometry stays in object space and is loaded once per file
+Mesh* loadMesh(const std::string& filepath, Scene& scene)
 {
+    TRACE_SCOPE("loadMesh");
+
+    auto cached = scene.meshes.find(filepath);
+    if (cached != scene.meshes.end()) {
+        return cached->second;
+    }
+
     struct Face { int i1, i2, i3; };
 
     std::ifstream file(filepath);
     if (!file.is_open()) {
         std::cerr << "Error: Failed to open mesh file: " << filepath << "\n";
-        return;
+        return nullptr;
     }
 
     std::vector<Vector3> vertices;
@@ -40,13 +49,7 @@ void loadMesh(const std::string& filepath,
         if (type == "v") {
             float x, y, z;
             iss >> x >> y >> z;
-
-            Vector3 v(x, y, z);
-            Matrix3 rot = Matrix3::fromEuler(rotation.x, rotation.y, rotation.z);
-
-            // Apply scale then rotation then translation
-            Vector3 transformed = rot * (v * scale) + translation;
-            vertices.push_back(transformed);
+            vertices.emplace_back(x, y, z);
         }
 
         // Face
@@ -90,24 +93,86 @@ void loadMesh(const std::string& filepath,
     }
 
     // Build triangles using smoothed normals
+    if (faces.empty()) {
+        std::cerr << "Error: Mesh has no faces: " << filepath << "\n";
+        return nullptr;
+    }
+
+    // Triangles keep the default material and own nothing, so they are
+    // packed back to back and never destroyed one by one
+    Memory::check("creating mesh triangles", faces.size() * (sizeof(Triangle) + sizeof(Shape*)));
+    Mesh* mesh = scene.instances.make<Mesh>();
+    mesh->triangles.reserve(faces.size());
+    scene.triangles.reserve(faces.size() * sizeof(Triangle));
     for (const Face& f : faces) {
-        Triangle* tri = new Triangle(
+        mesh->triangles.push_back(scene.triangles.makeTrivial<Triangle>(
             vertices[f.i1], vertices[f.i2], vertices[f.i3],
             vertexNormals[f.i1], vertexNormals[f.i2], vertexNormals[f.i3]
-        );
-        tri->material = mat;
-        scene.shapes.push_back(tri);
+        ));
     }
 
+    scene.meshes[filepath] = mesh;
+
     std::cout << "Loaded mesh: " << filepath
               << " (" << vertices.size() << " vertices)\n";
+
+    return mesh;
 }
 
 
 
+// Group spheres into spatially close sets of up to 8
+static void packSpheres(std::vector<Sphere*>& spheres, size_t start, size_t end, Scene& scene)
+{
+    size_t count = end - start;
+
+    if (count == 1) {
+        scene.shapes.push_back(spheres[start]);
+        return;
+    }
+    if (count <= (size_t)SphereSet::WIDTH) {
+        scene.shapes.push_back(scene.spheres.make<SphereSet>(&spheres[start], (int)count));
+        return;
+    }
+
+    // Split along the longest axis, keeping the left side a multiple of 8
+    AABB box;
+    for (size_t i = start; i < end; ++i) {
+        box.expand(spheres[i]->translation);
+    }
+    int axis = box.longestAxis();
+
+    size_t half = (count / 2 + SphereSet::WIDTH - 1) / SphereSet::WIDTH * SphereSet::WIDTH;
+    size_t mid = start + std::min(half, count - 1);
+
+    std::nth_element(spheres.begin() + start, spheres.begin() + mid, spheres.begin() + end,
+        [axis](const Sphere* a, const Sphere* b) {
+            if (axis == 0) return a->translation.x < b->translation.x;
+            if (axis == 1) return a->translation.y < b->translation.y;
+            return a->translation.z < b->translation.z;
+        });
+
+    packSpheres(spheres, start, mid, scene);
+    packSpheres(spheres, mid, end, scene);
+}
+
+// Add a shape, wrapped in a MovingShape when it has a different end translation
+static void addShape(Shape* s, const Vector3& start, const Vector3& end, Scene& scene)
+{
+    Vector3 motion = end - start;
+    if (motion.x != 0.0f || motion.y != 0.0f || motion.z != 0.0f) {
+        scene.shapes.push_back(scene.moving.make<MovingShape>(s, motion));
+        scene.hasMotion = true;
+    } else {
+        scene.shapes.push_back(s);
+    }
+}
+
 // Scene loader
 bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
 {
+    TRACE_SCOPE("loadScene");
+
     // Open file
     std::ifstream file(filename);
     if (!file.is_open()) {
@@ -117,6 +182,9 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
 
     std::string label;;
 
+    // Simple spheres, packed into SphereSets once loading is done
+    std::vector<Sphere*> packable;
+
     while (file >> label) {
 
         // --- CAMERA ---
@@ -138,6 +206,8 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
 
             std::string token;
             Vector3 translation(0,0,0);
+            Vector3 translationEnd(0,0,0);
+            bool moves = false;
             Vector3 rotation(0,0,0);
             Vector3 scale(1,1,1);
 
@@ -145,6 +215,10 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
             
             while (file >> token && token != "END_CUBE") {
                 if (token == "translation") file >> translation.x >> translation.y >> translation.z;
+                else if (token == "translation_end") {
+                    file >> translationEnd.x >> translationEnd.y >> translationEnd.z;
+                    moves = true;
+                }
                 else if (token == "rotation") file >> rotation.x >> rotation.y >> rotation.z;
                 else if (token == "scale") file >> scale.x >> scale.y >> scale.z;
 
@@ -161,6 +235,7 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
                     if (!mat.textureName.empty() && mat.textureName != "none") {
 
                         std::string texturePath = "../Textures/" + mat.textureName;
+                        scene.textureFiles.insert(texturePath);
                         mat.texture = new Image(texturePath);
                         
                         if (mat.texture->width == 0) {
@@ -172,9 +247,13 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
                 }
             }
 
-            Cube* c = new Cube(translation, rotation, scale);
+            // Pick the cheapest variant for this transform
+            bool rotated = rotation.x != 0.0f || rotation.y != 0.0f || rotation.z != 0.0f;
+            Cube* c = rotated ? scene.cubes.make<Cube>(translation, rotation, scale)
+                              : scene.cubes.make<AxisAlignedCube>(translation, rotation, scale);
             c->material = mat; 
-            scene.shapes.push_back(c);
+            scene.objects.push_back(c);
+            addShape(c, translation, moves ? translationEnd : translation, scene);
             continue;
         }
 
@@ -183,6 +262,8 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
 
             std::string token;
             Vector3 translation(0,0,0);
+            Vector3 translationEnd(0,0,0);
+            bool moves = false;
             Vector3 rotation(0,0,0);
             Vector3 scale(1,1,1);
 
@@ -191,6 +272,10 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
 
             while (file >> token && token != "END_SPHERE") {
                 if (token == "translation") file >> translation.x >> translation.y >> translation.z;
+                else if (token == "translation_end") {
+                    file >> translationEnd.x >> translationEnd.y >> translationEnd.z;
+                    moves = true;
+                }
                 else if (token == "rotation") file >> rotation.x >> rotation.y >> rotation.z;
                 else if (token == "scale") file >> scale.x >> scale.y >> scale.z;
 
@@ -207,6 +292,7 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
                     if (!mat.textureName.empty() && mat.textureName != "none") {
 
                         std::string texturePath = "../Textures/" + mat.textureName;
+                        scene.textureFiles.insert(texturePath);
                         mat.texture = new Image(texturePath);
                         if (mat.texture->width == 0) {
                              std::cerr << "Failed to load texture: " << mat.textureName << ". Check file exists." << std::endl;
@@ -218,9 +304,24 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
             }
 
             
-            Sphere* s = new Sphere(translation, rotation, scale);
+            // Pick the cheapest variant for this transform
+            bool rotated = rotation.x != 0.0f || rotation.y != 0.0f || rotation.z != 0.0f;
+            Sphere* s;
+            if (UniformSphere::uniform(scale))
+                s = scene.spheres.make<UniformSphere>(translation, rotation, scale);
+            else if (rotated)
+                s = scene.spheres.make<Sphere>(translation, rotation, scale);
+            else
+                s = scene.spheres.make<AxisAlignedSphere>(translation, rotation, scale);
+
             s->material = mat;
-            scene.shapes.push_back(s);
+            scene.objects.push_back(s);
+            if (moves)
+                addShape(s, translation, translationEnd, scene);
+            else if (SphereSet::packable(rotation, scale))
+                packable.push_back(s);
+            else
+                scene.shapes.push_back(s);
             continue;
         }
 
@@ -250,6 +351,7 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
                     if (!mat.textureName.empty() && mat.textureName != "none") {
 
                         std::string texturePath = "../Textures/" + mat.textureName;
+                        scene.textureFiles.insert(texturePath);
                         mat.texture = new Image(texturePath);
                         if (mat.texture->width == 0) {
                              std::cerr << "Failed to load texture: " << mat.textureName << ". Check file exists." << std::endl;
@@ -261,8 +363,9 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
             }
 
             if (verts.size() == 4) {
-                Plane* p = new Plane(verts[0], verts[1], verts[2], verts[3]);
+                Plane* p = scene.planes.make<Plane>(verts[0], verts[1], verts[2], verts[3]);
                 p->material = mat;
+                scene.objects.push_back(p);
                 scene.shapes.push_back(p);
             }
             continue;
@@ -274,6 +377,8 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
             std::string token;
             std::string objFilename;
             Vector3 translation(0,0,0);
+            Vector3 translationEnd(0,0,0);
+            bool moves = false;
             Vector3 rotation(0,0,0);
             float scale = 1.0f;
             Material mat;
@@ -292,6 +397,11 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
                 else if (token == "translation")
                     file >> translation.x >> translation.y >> translation.z;
 
+                else if (token == "translation_end") {
+                    file >> translationEnd.x >> translationEnd.y >> translationEnd.z;
+                    moves = true;
+                }
+
                 else if (token == "rotation")
                     file >> rotation.x >> rotation.y >> rotation.z;
 
@@ -326,6 +436,7 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
                         mat.textureName != "none") {
 
                         std::string texturePath = "../Textures/" + mat.textureName;
+                        scene.textureFiles.insert(texturePath);
                         mat.texture = new Image(texturePath);
 
                         if (mat.texture->width == 0) {
@@ -337,8 +448,15 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
             }
 
             if (!objFilename.empty()) {
-                // Call simplified version-1 mesh loader
-                loadMesh(objFilename, translation, rotation, scale, mat, scene);
+                auto meshStart = std::chrono::steady_clock::now();
+                Mesh* mesh = loadMesh(objFilename, scene);
+                scene.meshSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - meshStart).count();
+                if (mesh) {
+                    MeshInstance* inst = scene.instances.make<MeshInstance>(mesh, translation, rotation, scale);
+                    inst->material = mat;
+                    scene.objects.push_back(inst);
+                    addShape(inst, translation, moves ? translationEnd : translation, scene);
+                }
             }
 
             continue;
@@ -371,6 +489,13 @@ bool loadScene(const std::string& filename, Camera& cam, Scene& scene)
         }
     }
 
+    if (!packable.empty()) {
+        size_t before = scene.shapes.size();
+        packSpheres(packable, 0, packable.size(), scene);
+        std::cout << "Packed " << packable.size() << " spheres into "
+                  << scene.shapes.size() - before << " shapes\n";
+    }
+
     std::cout << "Scene loaded successfully" << std::endl;
     file.close();
 
@@ -3,8 +3,12 @@
 
 #include "camera.h"
 #include "shapes/shape.h" 
+#include "shapes/instance.h"
+#include "arena.h"
 #include <vector>
 #include <string>
+#include <map>
+#include <set>
 
 struct Light {
     Vector3 position;
@@ -13,15 +17,25 @@ struct Light {
 };
 
 struct Scene {
+    static const size_t SMALL_BLOCK = 64 * 1024;    // for types with few objects
+
+    // One arena per primitive type, so each type's objects are contiguous
+    // and a loop over one type walks memory in order. Triangles come first:
+    // members are destroyed in reverse, so nothing outlives what it points to.
+    Arena triangles;                      // mesh triangles, one run per mesh
+    Arena spheres{ SMALL_BLOCK };         // spheres, then their SphereSets
+    Arena cubes{ SMALL_BLOCK };
+    Arena planes{ SMALL_BLOCK };
+    Arena instances{ SMALL_BLOCK };       // MeshInstance and Mesh
+    Arena moving{ SMALL_BLOCK };          // MovingShape wrappers
+
     std::vector<Shape*> shapes;
+    std::vector<Shape*> objects;          // every cube, sphere, plane and mesh instance in file order, the hit.shape values
     std::vector<Light> lights;
-
-    ~Scene() {
-        for (Shape* s : shapes) {
-            delete s;
-        }
-        shapes.clear();
-    }
+    std::map<std::string, Mesh*> meshes;  // keyed by file path
+    std::set<std::string> textureFiles;   // texture paths read, loaded or not, for caches that watch them
+    bool hasMotion = false;               // some shape has a translation_end
+    double meshSeconds = 0.0;             // part of loadScene spent reading OBJ files
 };
 
 bool loadScene(const std::string& filename, Camera& cam, Scene& scene);
@@ -0,0 +1,462 @@
+#include "server.h"
+#include "raytracer.h"
+#include "scene.h"
+#include "image.h"
+#include "accel.h"
+#include "json.h"
+#include "threadpool.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <filesystem>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Protocol: newline-delimited JSON over a Unix stream socket. Every request
+// is one object and gets one reply line; a client may send several jobs
+// without waiting, replies come back as jobs finish.
+//
+//   {"id": "a", "scene": "Test1.txt", "output": "a.ppm",
+//    "width": 320, "height": 180, "spp": 4, "shadowSamples": 4, "glossySamples": 4,
+//    "depth": 3, "exposure": 1, "tonemap": "aces", "seed": 1337,
+//    "camera": {"location": [0, 1, 5], "gaze": [0, 0, -1], "up": [0, 1, 0],
+//               "focal_length": 35, "aperture": 0, "focal_distance": 5}}
+//   -> {"id": "a", "status": "ok", "output": "../Output/a.ppm", "cached": true, "load_s": 0, "render_s": 0.41}
+//
+// Only "scene" and "output" are required; bare names resolve like -i and -o. Other commands:
+//   {"command": "stats"}     cached scenes and queued work
+//   {"command": "shutdown"}  finish running jobs, then exit
+
+using Clock = std::chrono::steady_clock;
+
+static double since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// One client; jobs keep it open until their reply is sent
+struct Connection {
+    int fd;
+    std::mutex writeLock;
+
+    explicit Connection(int f) : fd(f) {}
+    ~Connection() {
+        close(fd);
+    }
+
+    void send(const std::string& line) {
+        std::lock_guard<std::mutex> guard(writeLock);
+        std::string data = line + "\n";
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return;     // client went away
+            sent += n;
+        }
+    }
+};
+
+// A scene file with its acceleration structures, shared by all jobs on it
+struct LoadedScene {
+    std::string path;
+    std::filesystem::file_time_type modified;
+    std::map<std::string, std::filesystem::file_time_type> dependencies;   // mesh and texture files, as loaded
+    std::atomic<bool> loaded{false};        // dependencies filled in
+    Camera cam;
+    Scene scene;
+    Shape* accel = nullptr;
+    bool ok = false;
+    double loadSeconds = 0.0;
+    std::once_flag once;
+
+    ~LoadedScene() {
+        delete accel;
+    }
+
+    static std::filesystem::file_time_type modifiedTime(const std::string& file) {
+        std::error_code ec;
+        return std::filesystem::last_write_time(file, ec);     // min() for a missing file
+    }
+
+    // A scene still loading has nothing to compare yet and counts as current
+    bool dependenciesUnchanged() const {
+        if (!loaded) return true;
+        for (const auto& d : dependencies) {
+            if (modifiedTime(d.first) != d.second) return false;
+        }
+        return true;
+    }
+};
+
+// Most recently used first; evicted scenes live on until their last job ends
+class SceneCache {
+public:
+    SceneCache(size_t capacity, const RenderConfig& config) : capacity(std::max<size_t>(1, capacity)), config(config) {}
+
+    // Null when the scene failed to load; cached is false when this call loaded it
+    std::shared_ptr<LoadedScene> get(const std::string& path, bool& cached) {
+        auto modified = LoadedScene::modifiedTime(path);
+
+        std::shared_ptr<LoadedScene> entry;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if ((*it)->path != path) continue;
+                if ((*it)->modified == modified && (*it)->dependenciesUnchanged()) entry = *it;
+                entries.erase(it);     // stale ones are reloaded
+                break;
+            }
+            cached = (entry != nullptr);
+            if (!entry) {
+                entry = std::make_shared<LoadedScene>();
+                entry->path = path;
+                entry->modified = modified;
+            }
+            entries.push_front(entry);
+        }
+
+        // Jobs on a scene that is still loading wait here
+        std::call_once(entry->once, [&] { load(*entry); });
+
+        // Only loaded scenes push others out
+        std::lock_guard<std::mutex> guard(lock);
+        if (!entry->ok) {
+            entries.remove(entry);
+            return nullptr;
+        }
+        while (entries.size() > capacity && entries.back() != entry) {
+            std::cout << "Evicting " << entries.back()->path << "\n";
+            entries.pop_back();
+        }
+        return entry;
+    }
+
+    std::string describe() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::ostringstream out;
+        out << "[";
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            const LoadedScene& s = **it;
+            out << (it == entries.begin() ? "" : ", ") << "{\"path\": " << Json::quote(s.path)
+                << ", \"shapes\": " << s.scene.shapes.size() << ", \"load_s\": " << s.loadSeconds << "}";
+        }
+        out << "]";
+        return out.str();
+    }
+
+private:
+    std::mutex lock;
+    std::list<std::shared_ptr<LoadedScene>> entries;
+    size_t capacity;
+    RenderConfig config;
+
+    void load(LoadedScene& s) {
+        auto start = Clock::now();
+        if (!loadScene(s.path, s.cam, s.scene)) return;
+        for (const auto& m : s.scene.meshes) s.dependencies[m.first] = LoadedScene::modifiedTime(m.first);
+        for (const std::string& t : s.scene.textureFiles) s.dependencies[t] = LoadedScene::modifiedTime(t);
+        s.loaded = true;
+        s.accel = buildAcceleration(s.scene, config);
+        s.loadSeconds = since(start);
+        s.ok = true;
+        std::cout << "Loaded " << s.path << " in " << s.loadSeconds << " s (" << s.scene.shapes.size() << " shapes)\n";
+    }
+};
+
+// Render job, split into row bands that any pool thread can take
+struct Job {
+    std::string id;
+    std::string output;
+    std::shared_ptr<Connection> client;
+    std::shared_ptr<LoadedScene> loaded;
+    Camera cam;
+    RenderConfig config;
+    std::unique_ptr<Raytracer> tracer;
+    std::unique_ptr<Image> img;
+    bool cached = false;
+    double loadSeconds = 0.0;
+    Clock::time_point start;
+
+    int bands = 0;
+    std::atomic<int> nextBand{0};
+    std::atomic<int> doneBands{0};
+};
+
+class Server {
+public:
+    explicit Server(const RenderConfig& defaults)
+        : defaults(defaults), pool(defaults.renderThreads), cache(defaults.cacheScenes, defaults) {}
+
+    int run() {
+        const std::string& path = defaults.serveSocket;
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Socket path too long: " << path << "\n";
+            return 1;
+        }
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str());
+        if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 16) != 0) {
+            std::cerr << "Cannot listen on " << path << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+        std::cout << "Serving on " << path << " with " << pool.size() << " render threads, "
+                  << std::max(1, defaults.cacheScenes) << " cached scenes\n";
+
+        for (;;) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (stopping) {
+                if (fd >= 0) close(fd);
+                break;
+            }
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            auto client = std::make_shared<Connection>(fd);
+            std::lock_guard<std::mutex> guard(lock);
+            clients.insert(fd);
+            std::thread([this, client] { serve(client); }).detach();
+        }
+
+        // Unblock the readers, then let running jobs finish
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            for (int fd : clients) shutdown(fd, SHUT_RD);
+            idle.wait(guard, [this] { return clients.empty() && activeJobs == 0; });
+        }
+        close(listenFd);
+        unlink(path.c_str());
+        std::cout << "Server stopped\n";
+        return 0;
+    }
+
+private:
+    RenderConfig defaults;
+    ThreadPool pool;
+    SceneCache cache;
+    int listenFd = -1;
+    std::atomic<bool> stopping{false};
+
+    std::mutex lock;
+    std::condition_variable idle;
+    std::set<int> clients;      // one detached reader thread each
+    int activeJobs = 0;
+
+    static const int BAND_ROWS = 8;
+
+    // Reads request lines until the client closes
+    void serve(std::shared_ptr<Connection> client) {
+        std::string buffer;
+        char chunk[4096];
+        for (;;) {
+            ssize_t n = recv(client->fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) break;
+            buffer.append(chunk, n);
+
+            size_t newline;
+            while ((newline = buffer.find('\n')) != std::string::npos) {
+                std::string line = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+                if (line.find_first_not_of(" \t\r") != std::string::npos) handle(line, client);
+            }
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        clients.erase(client->fd);
+        idle.notify_all();
+    }
+
+    static std::string error(const std::string& id, const std::string& message) {
+        return "{\"id\": " + Json::quote(id) + ", \"status\": \"error\", \"message\": " + Json::quote(message) + "}";
+    }
+
+    void handle(const std::string& line, const std::shared_ptr<Connection>& client) {
+        Json::Value request;
+        Json::Parser parser(line);
+        if (!parser.parse(request) || request.type != Json::Value::Object) {
+            client->send(error("", "bad request: " + (parser.error.empty() ? "not an object" : parser.error)));
+            return;
+        }
+        std::string id = request["id"].str("");
+
+        std::string command = request["command"].str("render");
+        if (command == "shutdown") {
+            client->send("{\"id\": " + Json::quote(id) + ", \"status\": \"ok\"}");
+            stopping = true;
+            shutdown(listenFd, SHUT_RDWR);
+            return;
+        }
+        if (command == "stats") {
+            int jobs;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                jobs = activeJobs;
+            }
+            client->send("{\"id\": " + Json::quote(id) + ", \"status\": \"ok\", \"jobs\": " + std::to_string(jobs)
+                         + ", \"queued\": " + std::to_string(pool.queued()) + ", \"scenes\": " + cache.describe() + "}");
+            return;
+        }
+        if (command != "render") {
+            client->send(error(id, "unknown command " + command));
+            return;
+        }
+        if (stopping) {
+            client->send(error(id, "server is shutting down"));
+            return;
+        }
+
+        auto job = std::make_shared<Job>();
+        job->id = id;
+        job->client = client;
+        job->start = Clock::now();
+        std::string message;
+        if (!prepare(*job, request, message)) {
+            client->send(error(id, message));
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            activeJobs++;
+        }
+
+        // One task per pool thread at most; each renders a band and queues
+        // itself again behind other jobs' bands, so concurrent jobs share the pool
+        int workers = std::min(job->bands, pool.size());
+        for (int i = 0; i < workers; ++i) {
+            pool.submit([this, job] { renderBand(job); });
+        }
+    }
+
+    // Settings, scene and camera of a render request
+    bool prepare(Job& job, const Json::Value& request, std::string& message) {
+        std::string scenePath = request["scene"].str("");
+        job.output = request["output"].str("");
+        if (scenePath.empty() || job.output.empty()) {
+            message = "a render job needs \"scene\" and \"output\"";
+            return false;
+        }
+        // Bare file names resolve like -i and -o
+        auto bare = [](const std::string& name) {
+            return name.find('/') == std::string::npos && name.find('\\') == std::string::npos;
+        };
+        if (bare(scenePath)) scenePath = "../ASCII/" + scenePath;
+        if (bare(job.output)) job.output = "../Output/" + job.output;
+
+        RenderConfig& c = job.config;
+        c = defaults;
+        c.inputScene = scenePath;
+        c.outputImage = job.output;
+        c.heatmap = HeatmapMode::Off;
+        c.captureFile.clear();
+        c.width = (int)request["width"].num(c.width);
+        c.height = (int)request["height"].num(c.height);
+        c.samplesPerPixel = (int)request["spp"].num(c.samplesPerPixel);
+        c.shadowSamples = (int)request["shadowSamples"].num(c.shadowSamples);
+        c.glossySamples = (int)request["glossySamples"].num(c.glossySamples);
+        c.maxDepth = (int)request["depth"].num(c.maxDepth);
+        c.exposure = (float)request["exposure"].num(c.exposure);
+        c.seed = (uint64_t)request["seed"].num((double)c.seed);
+        std::string tonemap = request["tonemap"].str("");
+        if (tonemap == "none") c.toneMapping = ToneMappingMode::None;
+        else if (tonemap == "reinhard") c.toneMapping = ToneMappingMode::Reinhard;
+        else if (tonemap == "aces") c.toneMapping = ToneMappingMode::ACES;
+        else if (!tonemap.empty()) {
+            message = "unknown tonemap " + tonemap;
+            return false;
+        }
+
+        job.loaded = cache.get(scenePath, job.cached);
+        if (!job.loaded) {
+            message = "failed to load " + scenePath;
+            return false;
+        }
+        job.loadSeconds = job.cached ? 0.0 : job.loaded->loadSeconds;
+
+        // Camera overrides use the scene file's names
+        job.cam = job.loaded->cam;
+        const Json::Value& cam = request["camera"];
+        auto vec = [&](const char* key, Vector3& v) {
+            const Json::Value& a = cam[key];
+            if (a.type == Json::Value::Array && a.array.size() == 3) {
+                v = Vector3((float)a.array[0].num(0), (float)a.array[1].num(0), (float)a.array[2].num(0));
+            }
+        };
+        vec("location", job.cam.location);
+        vec("gaze", job.cam.gaze);
+        vec("up", job.cam.cameraUp);
+        vec("velocity", job.cam.velocity);
+        job.cam.focalLength = (float)cam["focal_length"].num(job.cam.focalLength);
+        job.cam.aperture = (float)cam["aperture"].num(job.cam.aperture);
+        job.cam.focalDistance = (float)cam["focal_distance"].num(job.cam.focalDistance);
+        if (c.width > 0) job.cam.resolutionX = c.width;
+        if (c.height > 0) job.cam.resolutionY = c.height;
+        job.cam.calculateBasis();
+
+        if (job.cam.resolutionX <= 0 || job.cam.resolutionY <= 0) {
+            message = "no resolution";
+            return false;
+        }
+
+        job.tracer.reset(new Raytracer(&job.cam, &job.loaded->scene, job.loaded->accel, c));
+        job.img.reset(new Image(job.cam.resolutionX, job.cam.resolutionY));
+        job.bands = (job.cam.resolutionY + BAND_ROWS - 1) / BAND_ROWS;
+        return true;
+    }
+
+    void renderBand(const std::shared_ptr<Job>& job) {
+        int band = job->nextBand++;
+        if (band >= job->bands) return;
+
+        int height = job->img->getHeight();
+        Tile tile{ 0, band * BAND_ROWS, job->img->getWidth(), std::min(height, (band + 1) * BAND_ROWS) };
+        job->tracer->renderTile(*job->img, tile);
+
+        if (job->doneBands.fetch_add(1) + 1 == job->bands) {
+            finish(*job);
+            return;
+        }
+        if (job->nextBand < job->bands) {
+            pool.submit([this, job] { renderBand(job); });
+        }
+    }
+
+    void finish(Job& job) {
+        double seconds = since(job.start);
+        std::ostringstream reply;
+        if (job.img->writePPM(job.output)) {
+            reply << "{\"id\": " << Json::quote(job.id) << ", \"status\": \"ok\", \"output\": " << Json::quote(job.output)
+                  << ", \"cached\": " << (job.cached ? "true" : "false") << ", \"load_s\": " << job.loadSeconds
+                  << ", \"render_s\": " << seconds - job.loadSeconds << "}";
+        } else {
+            reply << error(job.id, "cannot write " + job.output);
+        }
+        job.client->send(reply.str());
+        std::cout << "Job " << (job.id.empty() ? "-" : job.id) << ": " << job.config.inputScene << " "
+                  << job.img->getWidth() << "x" << job.img->getHeight() << " in " << seconds << " s"
+                  << (job.cached ? " (cached)" : "") << "\n";
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (--activeJobs == 0) idle.notify_all();
+    }
+};
+
+int runServer(const RenderConfig& defaults) {
+    Server server(defaults);
+    return server.run();
+}
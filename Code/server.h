@@ -0,0 +1,11 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "config.h"
+
+// Render daemon (--serve socket): scenes and their acceleration structures
+// stay loaded between jobs, jobs arrive as JSON lines, see server.cpp.
+// The command-line settings are the defaults of every job. Returns the exit code.
+int runServer(const RenderConfig& defaults);
+
+#endif
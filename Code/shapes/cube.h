@@ -9,6 +9,7 @@ class Cube : public Shape {
 public:
     Vector3 translation;
     Matrix3 rotation;
+    Matrix3 invRotation;    // world to object, transpose of rotation
     Vector3 halfExtent;
     
     Cube(const Vector3& t, const Vector3& eulerRadians, const Vector3& scale)
@@ -18,56 +19,46 @@ public:
         rotation = Matrix3::fromEuler(eulerRadians.x,
                                       eulerRadians.y,
                                       eulerRadians.z);
+        invRotation = rotation.transpose();
     }
 
+    // Rebuild the inverse after rotation was edited
+    void refit() override {
+        invRotation = rotation.transpose();
+    }
 
-    bool intersect(const Ray& ray, HitInfo& hit) const override {
 
-        // Transform ray to local space 
-        Matrix3 reverse_rotation = rotation.transpose();
-        Vector3 o_local = reverse_rotation * (ray.origin - translation);
-        Vector3 d_local = reverse_rotation * ray.direction;
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        return intersectImpl<true>(ray, hit);
+    }
 
-        float t_min = -std::numeric_limits<float>::infinity();
-        float t_max =  std::numeric_limits<float>::infinity();
+    static float nonZero(float d) {
+        return std::fabs(d) < EPS_DIR ? std::copysign(EPS_DIR, d) : d;
+    }
 
-        // "Slab Method" https://en.wikipedia.org/wiki/Slab_method
+    template <bool Rotated>
+    bool intersectImpl(const Ray& ray, HitInfo& hit) const {
+        RT_STAT(STAT_TEST_CUBE);
 
-        // X slab
-        if (std::fabs(d_local.x) < EPS_DIR) {
-            if (o_local.x < -halfExtent.x || o_local.x > halfExtent.x) return false;
-        } else {
-            float t0 = (-halfExtent.x - o_local.x) / d_local.x;
-            float t1 = ( halfExtent.x - o_local.x) / d_local.x;
-            if (t0 > t1) std::swap(t0, t1);
-            t_min = std::max(t_min, t0);
-            t_max = std::min(t_max, t1);
-            if (t_max < t_min) return false;
+        // Transform ray to local space 
+        Vector3 o_local = ray.origin - translation;
+        Vector3 d_local = ray.direction;
+        if constexpr (Rotated) {
+            o_local = invRotation * o_local;
+            d_local = invRotation * d_local;
         }
 
-        // Y slab
-        if (std::fabs(d_local.y) < EPS_DIR) {
-            if (o_local.y < -halfExtent.y || o_local.y > halfExtent.y) return false;
-        } else {
-            float t0 = (-halfExtent.y - o_local.y) / d_local.y;
-            float t1 = ( halfExtent.y - o_local.y) / d_local.y;
-            if (t0 > t1) std::swap(t0, t1);
-            t_min = std::max(t_min, t0);
-            t_max = std::min(t_max, t1);
-            if (t_max < t_min) return false;
-        }
+        // "Slab Method" https://en.wikipedia.org/wiki/Slab_method
+        // Components below EPS_DIR become +-EPS_DIR, so a ray parallel to a slab
+        // gets huge finite t's (never 0 * inf = NaN when it starts on the plane)
+        Vector3 invD(1.0f / nonZero(d_local.x), 1.0f / nonZero(d_local.y), 1.0f / nonZero(d_local.z));
+        Vector3 t0 = (-halfExtent - o_local) * invD;
+        Vector3 t1 = ( halfExtent - o_local) * invD;
 
-        // Z slab
-        if (std::fabs(d_local.z) < EPS_DIR) {
-            if (o_local.z < -halfExtent.z || o_local.z > halfExtent.z) return false;
-        } else {
-            float t0 = (-halfExtent.z - o_local.z) / d_local.z;
-            float t1 = ( halfExtent.z - o_local.z) / d_local.z;
-            if (t0 > t1) std::swap(t0, t1);
-            t_min = std::max(t_min, t0);
-            t_max = std::min(t_max, t1);
-            if (t_max < t_min) return false;
-        }
+        float t_min = std::max(std::max(std::min(t0.x, t1.x), std::min(t0.y, t1.y)), std::min(t0.z, t1.z));
+        float t_max = std::min(std::min(std::max(t0.x, t1.x), std::max(t0.y, t1.y)), std::max(t0.z, t1.z));
+
+        if (t_max < t_min) return false;
 
         // Choose closest intersection
         float t_hit;
@@ -110,17 +101,20 @@ public:
             v = 0.5f * (p_local.y / halfExtent.y + 1.0f);
         }
 
-        Vector3 p_world = translation + rotation * p_local;
-        Vector3 n_world = rotation * n_local;
-        n_world.normalize();
-
         // Update HitInfo
         hit.hit    = true;
         hit.t      = t_hit;
-        hit.point  = p_world;
-        hit.normal = n_world;
         hit.shape  = (Shape*)this;
 
+        if constexpr (Rotated) {
+            hit.point  = translation + rotation * p_local;
+            hit.normal = rotation * n_local;
+            hit.normal.normalize();
+        } else {
+            hit.point  = translation + p_local;
+            hit.normal = n_local;
+        }
+
         hit.u = u;
         hit.v = v;
 
@@ -153,4 +147,14 @@ public:
 
 };
 
+// Cube with zero rotation, skips the ray transform
+class AxisAlignedCube : public Cube {
+public:
+    using Cube::Cube;
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        return intersectImpl<false>(ray, hit);
+    }
+};
+
 #endif
\ No newline at end of file
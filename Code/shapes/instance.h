@@ -0,0 +1,91 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "shape.h"
+#include <cmath>
+#include <vector>
+
+// Object-space triangles of one OBJ file, shared by all its instances
+// The triangles live in the scene's triangle arena, the BVH is owned
+struct Mesh {
+    std::vector<Shape*> triangles;
+    Shape* bvh = nullptr;   // built after loading by buildMeshBVHs (accel.h)
+
+    ~Mesh() {
+        delete bvh;
+    }
+};
+
+// Placed copy of a shared mesh BVH
+// Rays are moved into mesh space instead of copying the triangles
+class MeshInstance : public Shape {
+public:
+    const Mesh* mesh;       // bottom-level BVH in object space
+    Vector3 translation;
+    Matrix3 toWorld;        // rotation * scale
+    Matrix3 toLocal;        // inverse of toWorld
+
+    MeshInstance(const Mesh* m, const Vector3& t, const Vector3& eulerRadians, float scale)
+        : mesh(m), translation(t)
+    {
+        Matrix3 rotation = Matrix3::fromEuler(eulerRadians.x,
+                                              eulerRadians.y,
+                                              eulerRadians.z);
+        Matrix3 inverseRotation = rotation.transpose();
+
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                toWorld.m[i][j] = rotation.m[i][j] * scale;
+                toLocal.m[i][j] = inverseRotation.m[i][j] / scale;
+            }
+        }
+    }
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        RT_STAT(STAT_TEST_MESH_INSTANCE);
+
+        // Direction is not renormalised so t is the same in both spaces
+        Ray localRay(toLocal * (ray.origin - translation), toLocal * ray.direction, ray.time);
+
+        HitInfo local;
+        local.t = hit.t;
+
+        if (!mesh->bvh->intersect(localRay, local)) return false;
+
+        // Normals transform by the inverse transpose
+        Vector3 n_world = toLocal.transpose() * local.normal;
+        n_world.normalize();
+
+        // Update HitInfo
+        hit.hit    = true;
+        hit.t      = local.t;
+        hit.point  = translation + toWorld * local.point;
+        hit.normal = n_world;
+        hit.shape  = (Shape*)this;
+
+        hit.u = local.u;
+        hit.v = local.v;
+
+        return true;
+    }
+
+    Vector3 centroid() const override {
+        return translation + toWorld * mesh->bvh->centroid();
+    }
+
+    // Transform the corners of the mesh box
+    AABB bounds() const override {
+        AABB local = mesh->bvh->bounds();
+        AABB box;
+
+        for (int i = 0; i < 8; ++i) {
+            Vector3 corner((i & 1) ? local.max.x : local.min.x,
+                           (i & 2) ? local.max.y : local.min.y,
+                           (i & 4) ? local.max.z : local.min.z);
+            box.expand(translation + toWorld * corner);
+        }
+        return box;
+    }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef MOVING_H
+#define MOVING_H
+
+#include "shape.h"
+
+// Shape translated linearly over the shutter interval
+// Rays are moved back by the offset at their time instead of moving the shape
+class MovingShape : public Shape {
+public:
+    Shape* shape;       // placed at time 0, not owned
+    Vector3 motion;     // translation from time 0 to time 1
+
+    MovingShape(Shape* s, const Vector3& m) : shape(s), motion(m) {}
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        Vector3 offset = motion * ray.time;
+        Ray localRay(ray.origin - offset, ray.direction, ray.time);
+
+        if (!shape->intersect(localRay, hit)) return false;
+
+        hit.point = hit.point + offset;
+        return true;
+    }
+
+    AABB boundsAt(float t) const override {
+        AABB box = shape->bounds();
+        box.min = box.min + motion * t;
+        box.max = box.max + motion * t;
+        return box;
+    }
+
+    bool isMoving() const override {
+        return true;
+    }
+
+    // Swept over the whole interval
+    AABB bounds() const override {
+        return AABB::combine(boundsAt(0.0f), boundsAt(1.0f));
+    }
+
+    Vector3 centroid() const override {
+        return bounds().centre();
+    }
+
+    void refit() override {
+        shape->refit();
+    }
+};
+
+#endif
@@ -21,6 +21,7 @@ public:
     }
 
     bool intersect(const Ray& ray, HitInfo& hit) const override {
+        RT_STAT(STAT_TEST_PLANE);
 
         float denom = normal.dot(ray.direction);
         
@@ -5,6 +5,7 @@
 #include <limits>
 #include "../maths.h"  
 #include "../aabb.h"
+#include "../stats.h"
 
 class Image; 
 class Shape;
@@ -54,6 +55,13 @@ public:
     virtual bool intersect(const Ray& ray, HitInfo& hit) const = 0;
     virtual AABB bounds() const = 0;
     virtual Vector3 centroid() const = 0;
+
+    // Bounds at shutter time t, bounds() covers the whole interval
+    virtual AABB boundsAt(float /*t*/) const { return bounds(); }
+    virtual bool isMoving() const { return false; }
+
+    // Recompute cached data after the shape was edited (e.g. moved)
+    virtual void refit() {}
 };
 
 #endif
\ No newline at end of file
@@ -9,7 +9,9 @@ class Sphere : public Shape {
 public:
     Vector3 translation;
     Matrix3 rotation;
+    Matrix3 invRotation;    // world to object, transpose of rotation
     Vector3 scale;
+    Vector3 invScale;
     
     Sphere(const Vector3& t, const Vector3& eulerRadians, const Vector3& s)
         : translation(t), scale(s)
@@ -18,18 +20,35 @@ public:
         rotation = Matrix3::fromEuler(eulerRadians.x,
                                       eulerRadians.y,
                                       eulerRadians.z);
+        invRotation = rotation.transpose(); // Inverse of orthogonal rotation matrix
+        invScale = Vector3(1.0f / s.x, 1.0f / s.y, 1.0f / s.z);
+    }
+
+    // Rebuild the inverses after rotation or scale was edited
+    void refit() override {
+        invRotation = rotation.transpose();
+        invScale = Vector3(1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z);
     }
 
     bool intersect(const Ray& ray, HitInfo& hit) const override {
+        return intersectImpl<true>(ray, hit);
+    }
+
+    template <bool Rotated>
+    bool intersectImpl(const Ray& ray, HitInfo& hit) const {
+        RT_STAT(STAT_TEST_SPHERE);
 
         // Transform ray to local space 
-        Matrix3 reverse_rotation = rotation.transpose(); // Inverse of orthogonal rotation matrix
-        Vector3 o_local = reverse_rotation * (ray.origin - translation);
-        Vector3 d_local = reverse_rotation * ray.direction;
+        Vector3 o_local = ray.origin - translation;
+        Vector3 d_local = ray.direction;
+        if constexpr (Rotated) {
+            o_local = invRotation * o_local;
+            d_local = invRotation * d_local;
+        }
 
         // Scale
-        o_local = o_local / scale;
-        d_local = d_local / scale;
+        o_local = o_local * invScale;
+        d_local = d_local * invScale;
 
         // Solve |O + tD|^2 = 1
         float a = d_local.dot(d_local);         // d (dot) d
@@ -47,50 +66,47 @@ public:
         float t1 = (-b - sqrtD) / (2 * a);
         float t2 = (-b + sqrtD) / (2 * a);
 
-        float closest_t = std::numeric_limits<float>::infinity();
-
         // Choose closest intersection
-        if (t1 > EPS_HIT && t1 < closest_t) {
-            closest_t = t1;
-        }
-        else if (t2 > EPS_HIT && t2 < closest_t) {
-            closest_t = t2;
-        }
-        else {
-            return false;
-        }
+        float closest_t;
+        if (t1 > EPS_HIT)      closest_t = t1;
+        else if (t2 > EPS_HIT) closest_t = t2;
+        else                   return false;
 
         // Check if this intersection is closer than any previous hit
-        if (closest_t < hit.t) {
-
-            Vector3 p_local = o_local + d_local * closest_t;
-            Vector3 n_local = p_local;
-            n_local.normalize();
-
-            // Return to world space
-            Vector3 p_world = translation + rotation * (p_local * scale);
-
-            Vector3 n_world = rotation * (n_local / scale);
-            n_world.normalize();
+        if (closest_t >= hit.t) return false;
+
+        Vector3 p_local = o_local + d_local * closest_t;
+        Vector3 n_local = p_local;
+        n_local.normalize();
+
+        // Return to world space
+        Vector3 p_world = translation + (p_local * scale);
+        Vector3 n_world = n_local * invScale;
+        if constexpr (Rotated) {
+            p_world = translation + rotation * (p_local * scale);
+            n_world = rotation * n_world;
+        }
+        n_world.normalize();
 
-            // Update HitInfo
-            hit.hit = true;
-            hit.t = closest_t;
-            hit.point = p_world;
-            hit.normal = n_world;
-            hit.shape = (Shape*)this;
+        // Update HitInfo
+        hit.hit = true;
+        hit.t = closest_t;
+        hit.point = p_world;
+        hit.normal = n_world;
+        hit.shape = (Shape*)this;
 
-            // Convert point on sphere to coordinates
-            float theta = std::atan2(n_local.x, n_local.z);
-            float phi   = std::acos(n_local.y);
+        setUV(n_local, hit);
 
-            hit.u = (theta + M_PI) / (2.0f * M_PI);
-            hit.v = phi / M_PI;
+        return true;
+    }
 
-            return true;
-        }
+    // Convert point on sphere to coordinates
+    static void setUV(const Vector3& n_local, HitInfo& hit) {
+        float theta = std::atan2(n_local.x, n_local.z);
+        float phi   = std::acos(n_local.y);
 
-        return false;
+        hit.u = (theta + M_PI) / (2.0f * M_PI);
+        hit.v = phi / M_PI;
     }
 
     Vector3 centroid() const override {
@@ -120,4 +136,77 @@ public:
 
 };
 
+// Ellipsoid with zero rotation, skips the rotation of the ray
+class AxisAlignedSphere : public Sphere {
+public:
+    using Sphere::Sphere;
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        return intersectImpl<false>(ray, hit);
+    }
+};
+
+// Equal scale on all axes, solved in world space
+// Rotation only affects the texture coordinates
+class UniformSphere : public Sphere {
+public:
+    float radius;
+    float invRadius;
+    float radius2;
+
+    UniformSphere(const Vector3& t, const Vector3& eulerRadians, const Vector3& s)
+        : Sphere(t, eulerRadians, s), radius(s.x), invRadius(1.0f / s.x), radius2(s.x * s.x) {}
+
+    void refit() override {
+        Sphere::refit();
+        radius = scale.x;
+        invRadius = 1.0f / scale.x;
+        radius2 = scale.x * scale.x;
+    }
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        RT_STAT(STAT_TEST_SPHERE);
+
+        // Solve |O + tD - C|^2 = r^2
+        Vector3 oc = ray.origin - translation;
+        float a = ray.direction.dot(ray.direction);
+        float b = oc.dot(ray.direction);
+        float c = oc.dot(oc) - radius2;
+
+        float discriminant = b * b - a * c;
+        if (discriminant < 0.0f) return false;
+
+        float sqrtD = std::sqrt(discriminant);
+        float invA = 1.0f / a;
+        float t1 = (-b - sqrtD) * invA;
+        float t2 = (-b + sqrtD) * invA;
+
+        float closest_t;
+        if (t1 > EPS_HIT)      closest_t = t1;
+        else if (t2 > EPS_HIT) closest_t = t2;
+        else                   return false;
+
+        if (closest_t >= hit.t) return false;
+
+        Vector3 p_world = ray.origin + ray.direction * closest_t;
+        Vector3 n_world = (p_world - translation) * invRadius;
+        n_world.normalize();
+
+        // Update HitInfo
+        hit.hit = true;
+        hit.t = closest_t;
+        hit.point = p_world;
+        hit.normal = n_world;
+        hit.shape = (Shape*)this;
+
+        setUV(invRotation * n_world, hit);
+
+        return true;
+    }
+
+    static bool uniform(const Vector3& s) {
+        return s.x == s.y && s.y == s.z && s.x > 0.0f;
+    }
+};
+
 #endif
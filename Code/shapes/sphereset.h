@@ -0,0 +1,190 @@
+#ifndef SPHERESET_H
+#define SPHERESET_H
+
+#include "sphere.h"
+#include <cmath>
+#include <limits>
+
+// AVX2 kernel compiled on x86-64 whatever -m flags the build uses, taken
+// only when the CPU running the binary has AVX2
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SPHERESET_AVX2 1
+#include <immintrin.h>
+#endif
+
+// Up to 8 unrotated, uniformly scaled spheres packed as one BVH leaf
+// Stored structure-of-arrays so all lanes are tested together
+class SphereSet : public Shape {
+public:
+    static const int WIDTH = 8;
+
+    alignas(32) float cx[WIDTH];
+    alignas(32) float cy[WIDTH];
+    alignas(32) float cz[WIDTH];
+    alignas(32) float r2[WIDTH];
+    float radius[WIDTH];
+    Sphere* spheres[WIDTH];     // hit.shape of each lane, for its material
+    int count;
+
+    // The spheres stay owned by the caller (the scene's sphere arena)
+    SphereSet(Sphere* const* members, int n) : count(n) {
+        for (int i = 0; i < WIDTH; ++i) {
+            spheres[i] = (i < n) ? members[i] : nullptr;
+        }
+        refit();
+    }
+
+    // Re-read centres and radii from the member spheres
+    void refit() override {
+        for (int i = 0; i < WIDTH; ++i) {
+            if (i < count) {
+                const Sphere* s = spheres[i];
+                cx[i] = s->translation.x;
+                cy[i] = s->translation.y;
+                cz[i] = s->translation.z;
+                radius[i] = s->scale.x;
+                r2[i] = radius[i] * radius[i];
+            } else {
+                // Empty lane: negative radius^2 gives a negative discriminant
+                cx[i] = cy[i] = cz[i] = 0.0f;
+                radius[i] = 0.0f;
+                r2[i] = -1.0f;
+            }
+        }
+    }
+
+    // Unrotated sphere with equal scale on all axes
+    static bool packable(const Vector3& eulerRadians, const Vector3& scale) {
+        return eulerRadians.x == 0.0f && eulerRadians.y == 0.0f && eulerRadians.z == 0.0f &&
+               UniformSphere::uniform(scale);
+    }
+
+    bool intersect(const Ray& ray, HitInfo& hit) const override {
+        RT_STAT(STAT_TEST_SPHERE_SET);
+
+        // Solve |O + tD - C|^2 = r^2 for every lane
+        float a = ray.direction.dot(ray.direction);
+        float invA = 1.0f / a;
+
+        float closest_t = hit.t;
+#if defined(SPHERESET_AVX2)
+        int lane = hasAVX2() ? nearestAVX2(ray, a, invA, closest_t) : nearestScalar(ray, a, invA, closest_t);
+#else
+        int lane = nearestScalar(ray, a, invA, closest_t);
+#endif
+
+        if (lane < 0) return false;
+
+        Vector3 p_world = ray.origin + ray.direction * closest_t;
+        Vector3 n_world = (p_world - Vector3(cx[lane], cy[lane], cz[lane])) / radius[lane];
+        n_world.normalize();
+
+        // Update HitInfo
+        hit.hit = true;
+        hit.t = closest_t;
+        hit.point = p_world;
+        hit.normal = n_world;
+        hit.shape = spheres[lane];
+
+        Sphere::setUV(n_world, hit);
+
+        return true;
+    }
+
+#if defined(SPHERESET_AVX2)
+    static bool hasAVX2() {
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+    }
+
+    // All 8 lanes at once; same arithmetic as nearestScalar, so the same hits
+    __attribute__((target("avx2")))
+    int nearestAVX2(const Ray& ray, float a, float invA, float& closest_t) const {
+        int lane = -1;
+
+        const __m256 ox = _mm256_set1_ps(ray.origin.x);
+        const __m256 oy = _mm256_set1_ps(ray.origin.y);
+        const __m256 oz = _mm256_set1_ps(ray.origin.z);
+        const __m256 dx = _mm256_set1_ps(ray.direction.x);
+        const __m256 dy = _mm256_set1_ps(ray.direction.y);
+        const __m256 dz = _mm256_set1_ps(ray.direction.z);
+
+        __m256 ocx = _mm256_sub_ps(ox, _mm256_load_ps(cx));
+        __m256 ocy = _mm256_sub_ps(oy, _mm256_load_ps(cy));
+        __m256 ocz = _mm256_sub_ps(oz, _mm256_load_ps(cz));
+
+        __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)),
+                                 _mm256_mul_ps(ocz, dz));
+        __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)),
+                                               _mm256_mul_ps(ocz, ocz)),
+                                 _mm256_load_ps(r2));
+        __m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(_mm256_set1_ps(a), c));
+
+        __m256 valid = _mm256_cmp_ps(disc, _mm256_setzero_ps(), _CMP_GE_OQ);
+        __m256 sqrtD = _mm256_sqrt_ps(_mm256_max_ps(disc, _mm256_setzero_ps()));
+        __m256 negB = _mm256_sub_ps(_mm256_setzero_ps(), b);
+        __m256 vInvA = _mm256_set1_ps(invA);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(negB, sqrtD), vInvA);
+        __m256 t2 = _mm256_mul_ps(_mm256_add_ps(negB, sqrtD), vInvA);
+
+        // Nearest root in front of the origin, infinity otherwise
+        const __m256 eps = _mm256_set1_ps(EPS_HIT);
+        const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+        __m256 t = _mm256_blendv_ps(inf, t2, _mm256_cmp_ps(t2, eps, _CMP_GT_OQ));
+        t = _mm256_blendv_ps(t, t1, _mm256_cmp_ps(t1, eps, _CMP_GT_OQ));
+        t = _mm256_blendv_ps(inf, t, valid);
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(t, _mm256_set1_ps(closest_t), _CMP_LT_OQ));
+        if (mask == 0) return -1;
+
+        alignas(32) float ts[WIDTH];
+        _mm256_store_ps(ts, t);
+        while (mask) {
+            int i = __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (ts[i] < closest_t) { closest_t = ts[i]; lane = i; }
+        }
+        return lane;
+    }
+#endif
+
+    // Nearest lane hit in front of the origin and before closest_t, -1 if none
+    int nearestScalar(const Ray& ray, float a, float invA, float& closest_t) const {
+        int lane = -1;
+        for (int i = 0; i < count; ++i) {
+            float ocx = ray.origin.x - cx[i];
+            float ocy = ray.origin.y - cy[i];
+            float ocz = ray.origin.z - cz[i];
+
+            float b = ocx * ray.direction.x + ocy * ray.direction.y + ocz * ray.direction.z;
+            float c = ocx * ocx + ocy * ocy + ocz * ocz - r2[i];
+            float disc = b * b - a * c;
+            if (disc < 0.0f) continue;
+
+            float sqrtD = std::sqrt(disc);
+            float t1 = (-b - sqrtD) * invA;
+            float t2 = (-b + sqrtD) * invA;
+
+            float t = (t1 > EPS_HIT) ? t1 : (t2 > EPS_HIT) ? t2 : closest_t;
+            if (t < closest_t) { closest_t = t; lane = i; }
+        }
+        return lane;
+    }
+
+    Vector3 centroid() const override {
+        return bounds().centre();
+    }
+
+    AABB bounds() const override {
+        AABB box;
+        for (int i = 0; i < count; ++i) {
+            Vector3 c(cx[i], cy[i], cz[i]);
+            Vector3 r(radius[i], radius[i], radius[i]);
+            box.expand(c - r);
+            box.expand(c + r);
+        }
+        return box;
+    }
+};
+
+#endif
@@ -30,6 +30,7 @@ public:
     }
 
     bool intersect(const Ray& ray, HitInfo& hit) const override {
+        RT_STAT(STAT_TEST_TRIANGLE);
 
         float denom = normal.dot(ray.direction);
         
@@ -0,0 +1,146 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+// Ray and traversal counters, compiled in with make STATS=1 (-DRT_STATS)
+// Every thread counts into its own block, blocks are summed after the render
+// Without RT_STATS, RT_STAT expands to nothing
+
+enum StatCounter {
+    STAT_PRIMARY_RAYS,
+    STAT_SHADOW_RAYS,
+    STAT_REFLECTION_RAYS,
+    STAT_REFRACTION_RAYS,
+    STAT_GLOSSY_RAYS,
+    STAT_BVH_NODES,
+    STAT_SHADOW_EARLY_OUTS,     // lights skipped as fully occluded
+    STAT_TEST_SPHERE,
+    STAT_TEST_SPHERE_SET,
+    STAT_TEST_CUBE,
+    STAT_TEST_PLANE,
+    STAT_TEST_TRIANGLE,
+    STAT_TEST_MESH_INSTANCE,
+    STAT_COUNT
+};
+
+#ifdef RT_STATS
+#define RT_STAT(counter) (Stats::local().counts[counter]++)
+#else
+#define RT_STAT(counter) ((void)0)
+#endif
+
+namespace Stats {
+
+inline const char* name(int counter) {
+    static const char* names[STAT_COUNT] = {
+        "primary_rays", "shadow_rays", "reflection_rays", "refraction_rays", "glossy_rays",
+        "bvh_nodes", "shadow_early_outs",
+        "sphere_tests", "sphere_set_tests", "cube_tests", "plane_tests", "triangle_tests",
+        "mesh_instance_tests"
+    };
+    return names[counter];
+}
+
+struct Block;
+
+// Live blocks, plus the totals of threads that already exited
+struct Registry {
+    std::mutex lock;
+    std::vector<Block*> live;
+    uint64_t retired[STAT_COUNT] = {};
+};
+
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+struct Block {
+    uint64_t counts[STAT_COUNT] = {};
+
+    Block() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.live.push_back(this);
+    }
+
+    ~Block() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        for (int i = 0; i < STAT_COUNT; ++i) r.retired[i] += counts[i];
+        for (size_t i = 0; i < r.live.size(); ++i) {
+            if (r.live[i] == this) {
+                r.live.erase(r.live.begin() + i);
+                break;
+            }
+        }
+    }
+};
+
+inline Block& local() {
+    thread_local Block block;
+    return block;
+}
+
+// Sum over all threads, call once rendering has finished
+inline void merge(uint64_t out[STAT_COUNT]) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    for (int i = 0; i < STAT_COUNT; ++i) out[i] = r.retired[i];
+    for (const Block* b : r.live) {
+        for (int i = 0; i < STAT_COUNT; ++i) out[i] += b->counts[i];
+    }
+}
+
+inline void reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    for (int i = 0; i < STAT_COUNT; ++i) r.retired[i] = 0;
+    for (Block* b : r.live) {
+        for (int i = 0; i < STAT_COUNT; ++i) b->counts[i] = 0;
+    }
+}
+
+// Counters and per-second rates for the render
+inline void print(double seconds) {
+    uint64_t counts[STAT_COUNT];
+    merge(counts);
+
+    std::cout << "Statistics:\n";
+    for (int i = 0; i < STAT_COUNT; ++i) {
+        std::cout << "  " << std::left << std::setw(22) << name(i) << std::right << std::setw(14) << counts[i];
+        if (seconds > 0.0) std::cout << "  (" << counts[i] / seconds / 1e6 << " M/s)";
+        std::cout << "\n";
+    }
+}
+
+inline bool writeJSON(const std::string& path, double seconds) {
+    uint64_t counts[STAT_COUNT];
+    merge(counts);
+
+    std::ofstream out(path);
+    if (!out) return false;
+
+    out << "{\n  \"render_seconds\": " << seconds << ",\n  \"counters\": {\n";
+    for (int i = 0; i < STAT_COUNT; ++i) {
+        out << "    \"" << name(i) << "\": " << counts[i] << (i + 1 < STAT_COUNT ? ",\n" : "\n");
+    }
+    out << "  },\n  \"per_second\": {\n";
+    for (int i = 0; i < STAT_COUNT; ++i) {
+        double rate = seconds > 0.0 ? counts[i] / seconds : 0.0;
+        out << "    \"" << name(i) << "\": " << rate << (i + 1 < STAT_COUNT ? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+    return true;
+}
+
+} // namespace Stats
+
+#endif
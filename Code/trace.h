@@ -0,0 +1,145 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+// Timeline markers written as Chrome trace-event JSON (--trace out.json)
+// Open in chrome://tracing or ui.perfetto.dev. Every thread appends to its
+// own buffer without locking; buffers are collected when the trace is written.
+// Scopes cost one flag check while tracing is off.
+
+namespace Trace {
+
+struct Event {
+    const char* name;           // string literal
+    uint64_t start;             // ns since the trace epoch
+    uint64_t duration;
+    int arg;                    // row index etc., -1 for none
+};
+
+struct Buffer;
+
+// Live buffers, plus the events of threads that already exited
+struct Registry {
+    std::mutex lock;
+    std::vector<Buffer*> live;
+    std::vector<std::pair<int, std::vector<Event>>> retired;
+    int nextThread = 0;
+    bool enabled = false;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+struct Buffer {
+    std::vector<Event> events;
+    int thread;
+
+    Buffer() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        thread = r.nextThread++;
+        r.live.push_back(this);
+    }
+
+    ~Buffer() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        if (!events.empty()) r.retired.emplace_back(thread, std::move(events));
+        for (size_t i = 0; i < r.live.size(); ++i) {
+            if (r.live[i] == this) {
+                r.live.erase(r.live.begin() + i);
+                break;
+            }
+        }
+    }
+};
+
+inline Buffer& local() {
+    thread_local Buffer buffer;
+    return buffer;
+}
+
+// Call before starting any threads
+inline void enable() {
+    registry().enabled = true;
+    local();
+}
+
+inline bool enabled() {
+    return registry().enabled;
+}
+
+inline uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+// Records its lifetime as one complete ("X") event
+class Scope {
+public:
+    explicit Scope(const char* n, int a = -1) : name(n), arg(a), on(enabled()) {
+        if (on) start = now();
+    }
+
+    ~Scope() {
+        if (on) local().events.push_back({ name, start, now() - start, arg });
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name;
+    int arg;
+    bool on;
+    uint64_t start = 0;
+};
+
+inline void writeEvents(std::ofstream& out, int thread, const std::vector<Event>& events, bool& first) {
+    out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+        << ",\"args\":{\"name\":\"" << (thread == 0 ? std::string("main") : "thread " + std::to_string(thread)) << "\"}}";
+    first = false;
+
+    for (const Event& e : events) {
+        out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+            << ",\"ts\":" << e.start / 1000.0 << ",\"dur\":" << e.duration / 1000.0;
+        if (e.arg >= 0) out << ",\"args\":{\"i\":" << e.arg << "}";
+        out << "}";
+    }
+}
+
+// Call once all worker threads have finished
+inline bool write(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+
+    out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& t : r.retired) writeEvents(out, t.first, t.second, first);
+    for (const Buffer* b : r.live) {
+        if (!b->events.empty()) writeEvents(out, b->thread, b->events, first);
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+
+} // namespace Trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(...) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+
+#endif